@@ -0,0 +1,691 @@
+// Scene benchmark harness: procedurally fills a row of rooms with floating candles, runs them
+// for a fixed number of frames through the application's own code (Shader, RoomModel,
+// CandleModel, ParticleEmitter under the EmitterManager, FlameLight, LightClusters, ShadowAtlas,
+// PostProcess) in a hidden window, and writes a JSON report:
+//   cpu_ms       per subsystem, wall time on the calling thread (submission for the GL ones)
+//   gpu_ms       per pass, from GPU timestamp queries
+//   allocations  operator new calls and bytes during setup and during the measured frames
+//   memory       peak live heap, peak resident set, buffer arena usage
+// The scene comes from a seeded generator and the frames use a fixed time step, so two runs of
+// the same options do the same work and their reports can be compared mechanically.
+// Run from the repository root, the shaders and textures are loaded by relative path.
+//
+//   --rooms N            rooms in a row along x, default 4
+//   --candles N          candles per room, default 16
+//   --emitters N         emitters per candle: 0 none, 1 core flame, 2 core and haze (default)
+//   --core-particles N   particle capacity of a core emitter, default 500
+//   --haze-particles N   and of a haze emitter, default 300
+//   --particles N        live particle budget over all emitters, default no limit
+//   --lights N           flame lights, the first N candles get one (default all)
+//   --light-radius R     default 4
+//   --no-shadows         skip the shadow atlas
+//   --path NAME          camera path: static, orbit (each room in turn) or fly (down the row)
+//   --frames N           measured frames, default 600
+//   --warmup N           frames run before measuring, default 60
+//   --size WxH           render size, default 1280x720
+//   --seed N             scene generator seed, default 1
+//   --out FILE           report path, default candle_bench.json ("-" for stdout)
+//
+// g++ -O2 -std=c++17 bench/candle_bench.cpp src/Shader.cpp src/CandleMesh.cpp src/MeshOptimizer.cpp src/MeshFile.cpp src/BufferArena.cpp src/ThreadPool.cpp src/LightClusters.cpp src/ShadowAtlas.cpp src/LightmapBaker.cpp src/GpuTimer.cpp src/PostProcess.cpp src/Profiler.cpp src/SceneIndex.cpp src/EmitterManager.cpp src/CurlNoise.cpp src/FlameLight.cpp src/CandleModel.cpp src/ParticleEmitter.cpp src/RoomModel.cpp -Iinclude -pthread -lglfw -lGLEW -lGL -o candle_bench
+// (or the candle_bench target of CMakeLists.txt)
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "BufferArena.h"
+#include "CandleModel.h"
+#include "CurlNoise.h"
+#include "EmitterManager.h"
+#include "FlameLight.h"
+#include "GpuTimer.h"
+#include "LightClusters.h"
+#include "ParticleEmitter.h"
+#include "PostProcess.h"
+#include "RoomModel.h"
+#include "SceneIndex.h"
+#include "Shader.h"
+#include "ShadowAtlas.h"
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>  // link with -lpsapi
+#else
+#include <sys/resource.h>
+#endif
+
+// Allocation counting: every operator new in the process goes through here and keeps its size
+// in front of the block, so delete knows how much it frees. Over-aligned news keep the library
+// versions and are not counted.
+static std::atomic<uint64_t> allocationCount(0);
+static std::atomic<uint64_t> allocatedBytes(0);
+static std::atomic<int64_t> liveBytes(0);
+static std::atomic<int64_t> peakLiveBytes(0);
+const size_t ALLOCATION_HEADER = 16; // keeps the blocks aligned like malloc's
+
+static void *CountedAllocate(size_t size) {
+    void *block = std::malloc(size + ALLOCATION_HEADER);
+    if (!block) {
+        return nullptr;
+    }
+    *(size_t *)block = size;
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    int64_t live = liveBytes.fetch_add((int64_t)size, std::memory_order_relaxed) + (int64_t)size;
+    int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    return (char *)block + ALLOCATION_HEADER;
+}
+
+static void CountedFree(void *pointer) {
+    if (!pointer) {
+        return;
+    }
+    char *block = (char *)pointer - ALLOCATION_HEADER;
+    liveBytes.fetch_sub((int64_t)*(size_t *)block, std::memory_order_relaxed);
+    std::free(block);
+}
+
+void *operator new(size_t size) {
+    void *pointer = CountedAllocate(size);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return CountedAllocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return CountedAllocate(size); }
+void operator delete(void *pointer) noexcept { CountedFree(pointer); }
+void operator delete[](void *pointer) noexcept { CountedFree(pointer); }
+void operator delete(void *pointer, size_t) noexcept { CountedFree(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { CountedFree(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { CountedFree(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { CountedFree(pointer); }
+
+// Peak resident set of the process in bytes, driver allocations included
+static uint64_t PeakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;         // bytes
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;  // kilobytes
+#endif
+#endif
+}
+
+// Same layout as the application's scene
+const float ROOM_HALF_SIZE = 5.0f;                  // RoomModel spans +-5
+const float ROOM_SPACING = 11.0f;                   // room centers along x, a gap so the walls do not z-fight
+const float CANDLE_MARGIN = 1.0f;                   // candles keep this far from the walls
+const float CANDLE_MIN_HEIGHT = -3.0f;
+const float CANDLE_MAX_HEIGHT = 1.0f;
+const float CANDLE_SCALE = 0.5f;
+const float CANDLE_BOUND_RADIUS = 0.3f;
+const glm::vec3 FLAME_OFFSET(0.0f, 0.3f, 0.0f);
+const glm::vec3 FLAME_LIGHT_COLOR(2.0f, 1.0f, 0.5f);
+const float CORE_EMISSION_RATE = 300.0f;
+const float HAZE_EMISSION_RATE = 100.0f;
+const float FLAME_BOUND_RADIUS = 0.25f;
+const float FLAME_BOUND_HEIGHT = 2.1f;
+const float TURBULENCE_STRENGTH = 0.15f;
+const float TURBULENCE_SCALE = 0.5f;
+const float SHADOW_MOVE_TOLERANCE = 0.2f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+const float ORBIT_RADIUS = 3.0f;
+const float TIME_STEP = 1.0f / 60.0f;
+const int GPU_TIMER_LATENCY = 4;
+
+enum class CameraPath { Static, Orbit, Fly };
+static const char *CAMERA_PATH_NAMES[] = { "static", "orbit", "fly" };
+
+struct BenchOptions {
+    int rooms = 4;
+    int candlesPerRoom = 16;
+    int emittersPerCandle = 2;
+    int coreParticles = 500;
+    int hazeParticles = 300;
+    int particleBudget = -1;    // -1: the sum of all capacities, never scales
+    int lights = -1;            // -1: one per candle
+    float lightRadius = 4.0f;
+    bool shadows = true;
+    CameraPath path = CameraPath::Orbit;
+    int frames = 600;
+    int warmupFrames = 60;
+    int width = 1280;
+    int height = 720;
+    uint32_t seed = 1;
+    std::string outPath = "candle_bench.json";
+};
+
+static bool ParseOptions(int argc, char **argv, BenchOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--rooms") == 0 && hasValue) {
+            options.rooms = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--candles") == 0 && hasValue) {
+            options.candlesPerRoom = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--emitters") == 0 && hasValue) {
+            options.emittersPerCandle = std::min(std::max(std::atoi(argv[++i]), 0), 2);
+        } else if (std::strcmp(argv[i], "--core-particles") == 0 && hasValue) {
+            options.coreParticles = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--haze-particles") == 0 && hasValue) {
+            options.hazeParticles = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--particles") == 0 && hasValue) {
+            options.particleBudget = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--lights") == 0 && hasValue) {
+            options.lights = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--light-radius") == 0 && hasValue) {
+            options.lightRadius = std::max(0.1f, (float)std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--no-shadows") == 0) {
+            options.shadows = false;
+        } else if (std::strcmp(argv[i], "--path") == 0 && hasValue) {
+            const char *name = argv[++i];
+            bool known = false;
+            for (int path = 0; path < 3; path++) {
+                if (std::strcmp(name, CAMERA_PATH_NAMES[path]) == 0) {
+                    options.path = (CameraPath)path;
+                    known = true;
+                }
+            }
+            if (!known) {
+                std::cerr << "Unknown camera path: " << name << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            options.warmupFrames = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--size") == 0 && hasValue) {
+            int width = 0, height = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width < 1 || height < 1) {
+                std::cerr << "Bad size, expected WxH: " << argv[i] << std::endl;
+                return false;
+            }
+            options.width = width;
+            options.height = height;
+        } else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) {
+            options.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--out") == 0 && hasValue) {
+            options.outPath = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Camera position and view direction at t in [0, 1] along the path
+static void CameraAt(const BenchOptions &options, float t, glm::vec3 &position, glm::vec3 &front) {
+    if (options.path == CameraPath::Orbit) {
+        // Every room gets an equal share of the frames and one full turn around its center
+        float roomT = t * options.rooms;
+        int room = std::min((int)roomT, options.rooms - 1);
+        float angle = (roomT - room) * 2.0f * 3.14159265f;
+        glm::vec3 center(room * ROOM_SPACING, 0.0f, 0.0f);
+        position = center + glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * ORBIT_RADIUS;
+        front = glm::normalize(center + glm::vec3(0.0f, -1.0f, 0.0f) - position);
+    } else if (options.path == CameraPath::Fly) {
+        // Down the middle of the row, swaying sideways, through the walls between the rooms
+        float start = -(ROOM_HALF_SIZE - 1.0f);
+        float end = (options.rooms - 1) * ROOM_SPACING + ROOM_HALF_SIZE - 1.0f;
+        position = glm::vec3(start + (end - start) * t, 0.0f, 2.0f * std::sin(t * 6.0f * 3.14159265f));
+        front = glm::normalize(glm::vec3(1.0f, -0.2f, 0.0f));
+    } else {
+        position = glm::vec3(0.0f, 0.0f, 3.0f);
+        front = glm::vec3(0.0f, 0.0f, -1.0f);
+    }
+}
+
+struct BenchCandle {
+    glm::vec3 position;
+    std::unique_ptr<ParticleEmitter> coreFlame;
+    std::unique_ptr<ParticleEmitter> haze;
+    int sceneObject = -1;
+    int light = -1;     // index into the flame lights, -1 without one
+};
+
+// The measured phases of a frame. The GL ones are also timed on the GPU under the same name.
+enum Subsystem { SIMULATION, CULLING, LIGHT_BINNING, SHADOWS, ROOMS, CANDLES, PARTICLES, POST, SUBSYSTEM_COUNT };
+static const char *SUBSYSTEM_NAMES[] = {
+    "simulation", "culling", "light_binning", "shadows", "rooms", "candles", "particles", "post"
+};
+static const bool SUBSYSTEM_GPU[] = { false, false, true, true, true, true, true, true };
+
+struct MsStats {
+    double average = 0.0, p50 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+static MsStats Stats(std::vector<double> samples) {
+    MsStats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    double total = 0.0;
+    for (double ms : samples) {
+        total += ms;
+    }
+    stats.average = total / samples.size();
+    stats.p50 = samples[(samples.size() - 1) / 2];
+    stats.p99 = samples[(size_t)std::ceil(0.99 * (samples.size() - 1))];
+    stats.max = samples.back();
+    return stats;
+}
+
+static void WriteStats(std::ostream &out, const MsStats &stats) {
+    out << "{\"avg\": " << stats.average << ", \"p50\": " << stats.p50 << ", \"p99\": " << stats.p99
+        << ", \"max\": " << stats.max << "}";
+}
+
+// Builds the scene, runs it and writes the report. Everything holding GL objects lives in here,
+// so it is gone before the context is.
+static bool RunBenchmark(const BenchOptions &options, GLFWwindow *window) {
+    uint64_t setupAllocations = allocationCount.load();
+    uint64_t setupBytes = allocatedBytes.load();
+    auto setupStart = std::chrono::steady_clock::now();
+
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    Shader roomShader("shaders/room.vert", "shaders/room.frag");
+    Shader candleShader("shaders/candle.vert", "shaders/candle.frag");
+    Shader particleShader("shaders/particle.vert", "shaders/particle.frag");
+    PostProcess postProcess(options.width, options.height);
+    // History covers every measured frame, the report's GPU numbers are over the whole run
+    GpuTimer gpuTimer(GPU_TIMER_LATENCY, options.frames);
+    GpuTimer warmupTimer(GPU_TIMER_LATENCY, 1);
+
+    BufferArena arena;
+    RoomModel room(arena);
+    CandleModel candle(arena);
+    ThreadPool threadPool;
+    LightClusters lightClusters(threadPool);
+    // Without shadows the atlas gets a single tier with no slots: every light stays unshadowed,
+    // the shaders still have something to bind
+    std::unique_ptr<ShadowAtlas> shadowAtlas(options.shadows ? new ShadowAtlas() : new ShadowAtlas(64, {{64, 0.0f, 0}}));
+    shadowAtlas->setMoveTolerance(SHADOW_MOVE_TOLERANCE);
+    CurlNoiseField curlNoise(threadPool);
+
+    // Scene: candles scattered over every room from the seed, each with its emitters and
+    // (for the first --lights of them) a flame light
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<float> spread(-(ROOM_HALF_SIZE - CANDLE_MARGIN), ROOM_HALF_SIZE - CANDLE_MARGIN);
+    std::uniform_real_distribution<float> height(CANDLE_MIN_HEIGHT, CANDLE_MAX_HEIGHT);
+    glm::vec3 candleExtent = glm::vec3(candle.getParams().radius, candle.getParams().height * 0.5f,
+                                       candle.getParams().radius) * CANDLE_SCALE;
+    int lightCount = options.lights < 0 ? options.rooms * options.candlesPerRoom
+                                        : std::min(options.lights, options.rooms * options.candlesPerRoom);
+    std::vector<BenchCandle> candles;
+    SceneIndex sceneIndex;
+    std::vector<ParticleEmitter *> emitters;
+    std::vector<int> emitterObjects;
+    EmitterLodSettings lodSettings;
+    EmitterManager emitterManager(lodSettings);
+    size_t particleCapacity = 0;
+    for (int r = 0; r < options.rooms; r++) {
+        for (int c = 0; c < options.candlesPerRoom; c++) {
+            BenchCandle benchCandle;
+            benchCandle.position = glm::vec3(r * ROOM_SPACING + spread(rng), height(rng), spread(rng));
+            glm::vec3 flamePos = benchCandle.position + FLAME_OFFSET;
+            Aabb bounds;
+            bounds.min = glm::min(benchCandle.position - candleExtent,
+                                  flamePos - glm::vec3(FLAME_BOUND_RADIUS, 0.0f, FLAME_BOUND_RADIUS));
+            bounds.max = glm::max(benchCandle.position + candleExtent,
+                                  flamePos + glm::vec3(FLAME_BOUND_RADIUS, FLAME_BOUND_HEIGHT, FLAME_BOUND_RADIUS));
+            benchCandle.sceneObject = sceneIndex.add(bounds);
+            if (options.emittersPerCandle >= 1) {
+                benchCandle.coreFlame.reset(new ParticleEmitter(arena, options.coreParticles, EmitterType::CoreFlame));
+                benchCandle.coreFlame->setEmissionPosition(flamePos);
+                emitters.push_back(benchCandle.coreFlame.get());
+                emitterObjects.push_back(benchCandle.sceneObject);
+                emitterManager.add(benchCandle.coreFlame.get(), CORE_EMISSION_RATE);
+                particleCapacity += options.coreParticles;
+            }
+            if (options.emittersPerCandle >= 2) {
+                benchCandle.haze.reset(new ParticleEmitter(arena, options.hazeParticles, EmitterType::HeatHaze));
+                benchCandle.haze->setEmissionPosition(flamePos);
+                emitters.push_back(benchCandle.haze.get());
+                emitterObjects.push_back(benchCandle.sceneObject);
+                emitterManager.add(benchCandle.haze.get(), HAZE_EMISSION_RATE);
+                particleCapacity += options.hazeParticles;
+            }
+            benchCandle.light = (int)candles.size() < lightCount ? (int)candles.size() : -1;
+            candles.push_back(std::move(benchCandle));
+        }
+    }
+    emitterManager.getSettings().particleBudget = options.particleBudget < 0 ? (int)particleCapacity
+                                                                            : options.particleBudget;
+    for (size_t i = 0; i < emitters.size(); i++) {
+        emitters[i]->setSeed((uint32_t)i + options.seed);
+        emitters[i]->setTurbulence(&curlNoise, TURBULENCE_STRENGTH, TURBULENCE_SCALE);
+    }
+    std::vector<FlameLight> flameLights(lightCount);
+    std::vector<PointLight> lights;
+    std::vector<std::vector<float>> particlePositions(emitters.size());
+    std::vector<int> visibleObjects;
+    std::vector<unsigned char> objectVisible(sceneIndex.getObjectCount(), 1);
+    std::vector<float> screenSizes;
+    std::vector<glm::vec4> changedCasters; // nothing moves, the flicker stays under the tolerance
+
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), (float)options.width / options.height, NEAR_PLANE, FAR_PLANE);
+    glm::vec2 screenSize((float)options.width, (float)options.height);
+    const glm::vec3 cameraUp(0.0f, 1.0f, 0.0f);
+
+    double setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+    setupAllocations = allocationCount.load() - setupAllocations;
+    setupBytes = allocatedBytes.load() - setupBytes;
+
+    std::vector<double> cpuSamples[SUBSYSTEM_COUNT];
+    std::vector<double> frameSamples;
+    for (std::vector<double> &samples : cpuSamples) {
+        samples.reserve(options.frames);
+    }
+    frameSamples.reserve(options.frames);
+    uint64_t frameAllocations = 0, frameBytes = 0;
+    double visibleCandleSum = 0.0, liveParticleSum = 0.0;
+    long long shadowFaces = 0;
+
+    for (int frame = -options.warmupFrames; frame < options.frames; frame++) {
+        bool measured = frame >= 0;
+        if (frame == 0) {
+            frameAllocations = allocationCount.load();
+            frameBytes = allocatedBytes.load();
+        }
+        GpuTimer &timer = measured ? gpuTimer : warmupTimer;
+        auto frameStart = std::chrono::steady_clock::now();
+        auto timed = [&](Subsystem subsystem, const auto &fn) {
+            auto start = std::chrono::steady_clock::now();
+            if (SUBSYSTEM_GPU[subsystem]) {
+                timer.begin(SUBSYSTEM_NAMES[subsystem]);
+            }
+            fn();
+            if (SUBSYSTEM_GPU[subsystem]) {
+                timer.end(SUBSYSTEM_NAMES[subsystem]);
+            }
+            if (measured) {
+                cpuSamples[subsystem].push_back(
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+        };
+
+        glm::vec3 cameraPos, cameraFront;
+        CameraAt(options, measured ? (float)frame / options.frames : 0.0f, cameraPos, cameraFront);
+        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+
+        timer.beginFrame();
+        timer.begin("frame");
+
+        // Emitters and lights, with the screen sizes of the last frame's culling like the
+        // application's simulation step
+        timed(SIMULATION, [&]() {
+            if (!screenSizes.empty()) {
+                for (size_t i = 0; i < emitters.size(); i++) {
+                    emitterManager.setScreenSize((int)i, screenSizes[emitterObjects[i]]);
+                }
+            }
+            emitterManager.update(TIME_STEP);
+            lights.clear();
+            for (const BenchCandle &benchCandle : candles) {
+                if (benchCandle.light < 0) {
+                    continue;
+                }
+                FlameLight &flameLight = flameLights[benchCandle.light];
+                if (benchCandle.coreFlame) {
+                    flameLight.update(benchCandle.coreFlame->getStats(), benchCandle.position + FLAME_OFFSET, TIME_STEP);
+                    lights.push_back({flameLight.getPosition(), options.lightRadius,
+                                      flameLight.getColor(FLAME_LIGHT_COLOR), flameLight.getIntensity()});
+                } else {
+                    lights.push_back({benchCandle.position + FLAME_OFFSET, options.lightRadius, FLAME_LIGHT_COLOR, 1.0f});
+                }
+            }
+            for (size_t i = 0; i < emitters.size(); i++) {
+                if (emitterManager.isVisible((int)i)) {
+                    emitters[i]->writePositions(particlePositions[i]);
+                } else {
+                    particlePositions[i].clear();
+                }
+            }
+        });
+
+        timed(CULLING, [&]() {
+            visibleObjects.clear();
+            sceneIndex.cull(frustumFromMatrix(proj * view), visibleObjects);
+            objectVisible.assign(sceneIndex.getObjectCount(), 0);
+            screenSizes.assign(sceneIndex.getObjectCount(), 0.0f);
+            for (int object : visibleObjects) {
+                objectVisible[object] = 1;
+                const Aabb &bounds = sceneIndex.getBounds(object);
+                float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+                float distance = glm::max(glm::length((bounds.min + bounds.max) * 0.5f - cameraPos), radius);
+                screenSizes[object] = radius * proj[1][1] * 0.5f * options.height / distance;
+            }
+        });
+
+        timed(LIGHT_BINNING, [&]() {
+            lightClusters.update(lights, view, proj, NEAR_PLANE, FAR_PLANE);
+        });
+
+        timed(SHADOWS, [&]() {
+            shadowAtlas->update(lights, cameraPos, changedCasters);
+            shadowAtlas->render([&](const Shader &shader, const PointLight &light) {
+                int lod = candle.lodCount() - 1;
+                for (const BenchCandle &benchCandle : candles) {
+                    if (glm::length(benchCandle.position - light.position) > light.radius + CANDLE_BOUND_RADIUS) {
+                        continue;
+                    }
+                    glm::mat4 model = glm::translate(glm::mat4(1.0f), benchCandle.position);
+                    model = glm::scale(model, glm::vec3(CANDLE_SCALE));
+                    shader.setMat4("uModel", model);
+                    candle.draw(lod);
+                }
+            });
+        });
+        if (measured) {
+            shadowFaces += shadowAtlas->getFacesRendered();
+        }
+
+        postProcess.beginScene(glm::vec4(0.05f, 0.05f, 0.05f, 1.0f));
+
+        // No lightmap: the bake is per room mesh and every room here shares one
+        timed(ROOMS, [&]() {
+            roomShader.use();
+            roomShader.setMat4("uProjection", proj);
+            roomShader.setMat4("uView", view);
+            roomShader.setVec3("viewPos", cameraPos);
+            lightClusters.bind(roomShader, 2, screenSize);
+            shadowAtlas->bind(roomShader, 5);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, room.albedoTexture);
+            roomShader.setInt("uAlbedoMap", 0);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, room.normalTexture);
+            roomShader.setInt("uNormalMap", 1);
+            roomShader.setInt("uLightmap", 7);
+            roomShader.setInt("uLightmapEnabled", 0);
+            glActiveTexture(GL_TEXTURE0);
+            for (int r = 0; r < options.rooms; r++) {
+                roomShader.setMat4("uModel", glm::translate(glm::mat4(1.0f), glm::vec3(r * ROOM_SPACING, 0.0f, 0.0f)));
+                room.draw();
+            }
+        });
+
+        timed(CANDLES, [&]() {
+            candleShader.use();
+            candleShader.setVec3("viewPos", cameraPos);
+            candleShader.setMat4("uProjection", proj);
+            candleShader.setMat4("uView", view);
+            candleShader.setVec3("candleColor", glm::vec3(0.1f, 0.8f, 0.7f));
+            lightClusters.bind(candleShader, 0, screenSize);
+            shadowAtlas->bind(candleShader, 3);
+            glDisable(GL_BLEND);
+            for (const BenchCandle &benchCandle : candles) {
+                if (!objectVisible[benchCandle.sceneObject]) {
+                    continue;
+                }
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), benchCandle.position);
+                model = glm::scale(model, glm::vec3(CANDLE_SCALE));
+                candleShader.setMat4("uModel", model);
+                float distance = glm::max(glm::length(benchCandle.position - cameraPos), 0.01f);
+                float projectedRadius = candle.getParams().radius * CANDLE_SCALE * proj[1][1] * 0.5f * options.height / distance;
+                candle.draw(candle.selectLod(projectedRadius));
+            }
+            glEnable(GL_BLEND);
+        });
+
+        // Additive particles at full resolution, the application's F4 path
+        timed(PARTICLES, [&]() {
+            particleShader.use();
+            particleShader.setMat4("uProjection", proj);
+            particleShader.setMat4("uView", view);
+            particleShader.setFloat("uPointScale", 1.0f);
+            for (size_t i = 0; i < emitters.size(); i++) {
+                if (objectVisible[emitterObjects[i]]) {
+                    emitters[i]->draw(particlePositions[i]);
+                }
+            }
+        });
+
+        timed(POST, [&]() {
+            postProcess.resolve(timer, 0, options.width, options.height);
+        });
+        arena.invalidateBinding();
+        timer.end("frame");
+
+        // Wall time of the whole frame, GPU included
+        glFinish();
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+        if (measured) {
+            frameSamples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+            visibleCandleSum += std::count(objectVisible.begin(), objectVisible.end(), 1);
+            liveParticleSum += emitterManager.getLiveParticles();
+        }
+    }
+    frameAllocations = allocationCount.load() - frameAllocations;
+    frameBytes = allocatedBytes.load() - frameBytes;
+
+    // The last frames' queries are done after the glFinish, collect them
+    for (int i = 0; i < GPU_TIMER_LATENCY; i++) {
+        gpuTimer.beginFrame();
+    }
+
+    std::ofstream file;
+    if (options.outPath != "-") {
+        file.open(options.outPath);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open " << options.outPath << std::endl;
+            return false;
+        }
+    }
+    std::ostream &out = options.outPath == "-" ? std::cout : file;
+    out << "{\n";
+    out << "  \"config\": {\"rooms\": " << options.rooms << ", \"candles_per_room\": " << options.candlesPerRoom
+        << ", \"emitters_per_candle\": " << options.emittersPerCandle
+        << ", \"core_particles\": " << options.coreParticles << ", \"haze_particles\": " << options.hazeParticles
+        << ", \"particle_budget\": " << emitterManager.getSettings().particleBudget
+        << ", \"lights\": " << lightCount << ", \"light_radius\": " << options.lightRadius
+        << ", \"shadows\": " << (options.shadows ? "true" : "false")
+        << ", \"camera_path\": \"" << CAMERA_PATH_NAMES[(int)options.path] << "\""
+        << ", \"frames\": " << options.frames << ", \"warmup_frames\": " << options.warmupFrames
+        << ", \"width\": " << options.width << ", \"height\": " << options.height
+        << ", \"seed\": " << options.seed << ", \"threads\": " << threadPool.getThreadCount() << "},\n";
+    out << "  \"setup_ms\": " << setupMs << ",\n";
+    out << "  \"frame_ms\": ";
+    WriteStats(out, Stats(frameSamples));
+    out << ",\n  \"cpu_ms\": {\n";
+    for (int s = 0; s < SUBSYSTEM_COUNT; s++) {
+        out << "    \"" << SUBSYSTEM_NAMES[s] << "\": ";
+        WriteStats(out, Stats(cpuSamples[s]));
+        out << (s + 1 < SUBSYSTEM_COUNT ? ",\n" : "\n");
+    }
+    out << "  },\n  \"gpu_ms\": {\n";
+    for (int s = 0; s < gpuTimer.getSectionCount(); s++) {
+        out << "    \"" << gpuTimer.getName(s) << "\": {\"avg\": " << gpuTimer.getAverageMs(s)
+            << ", \"p50\": " << gpuTimer.getPercentileMs(s, 50.0) << ", \"p99\": " << gpuTimer.getPercentileMs(s, 99.0)
+            << ", \"max\": " << gpuTimer.getPercentileMs(s, 100.0)
+            << ", \"samples\": " << gpuTimer.getSampleCount(s) << "}"
+            << (s + 1 < gpuTimer.getSectionCount() ? ",\n" : "\n");
+    }
+    out << "  },\n";
+    out << "  \"allocations\": {\"setup_count\": " << setupAllocations << ", \"setup_bytes\": " << setupBytes
+        << ", \"frame_count\": " << frameAllocations << ", \"frame_bytes\": " << frameBytes
+        << ", \"per_frame\": " << (double)frameAllocations / options.frames << "},\n";
+    out << "  \"memory\": {\"peak_heap_bytes\": " << peakLiveBytes.load() << ", \"peak_rss_bytes\": " << PeakResidentBytes()
+        << ", \"arena_vertex_bytes\": " << arena.getVertexBytesUsed() << ", \"arena_index_bytes\": " << arena.getIndexBytesUsed()
+        << "},\n";
+    out << "  \"scene\": {\"candles\": " << candles.size() << ", \"emitters\": " << emitters.size()
+        << ", \"avg_visible_candles\": " << visibleCandleSum / options.frames
+        << ", \"avg_live_particles\": " << liveParticleSum / options.frames
+        << ", \"shadow_faces_rendered\": " << shadowFaces << "}\n";
+    out << "}\n";
+    if (options.outPath != "-") {
+        std::cout << "Report written to " << options.outPath << std::endl;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(options.width, options.height, "candle_bench", nullptr, nullptr);
+    if (!window) {
+        std::cerr << "Failed to create window" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwSwapInterval(0); // measure the renderer, not the display
+
+    bool ok = RunBenchmark(options, window);
+    glfwTerminate();
+    return ok ? 0 : 1;
+}
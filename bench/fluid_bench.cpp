@@ -0,0 +1,51 @@
+// Flame fluid benchmark: steps FlameFluid at growing grid sizes, on the calling thread and
+// split over z slabs on the pool, and prints the time per step and per cell so the scaling
+// with grid size and thread count can be read off directly.
+// No GL context needed.
+//
+// g++ -O2 -std=c++17 bench/fluid_bench.cpp src/FlameFluid.cpp src/ThreadPool.cpp src/Profiler.cpp -Iinclude -pthread -o fluid_bench
+
+#include "FlameFluid.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+static double TimeSteps(FlameFluid &fluid, ThreadPool *pool, int steps) {
+    const float dt = 1.0f / 120.0f;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < steps; i++) {
+        fluid.step(dt, pool);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / steps;
+}
+
+int main() {
+    ThreadPool pool;
+    std::printf("%d threads\n", pool.getThreadCount());
+    std::printf("%-12s %9s %12s %12s %9s %12s\n", "grid", "cells", "1 thread ms", "pool ms", "speedup", "ns/cell");
+
+    const int sizes[][3] = { {8, 16, 8}, {16, 32, 16}, {32, 64, 32}, {64, 128, 64} };
+    for (const int *size : sizes) {
+        FluidSettings settings;
+        settings.sizeX = size[0];
+        settings.sizeY = size[1];
+        settings.sizeZ = size[2];
+        // Same flame in cells at every size, so the larger grids have more smoke to carry
+        FlameFluid serial(settings), parallel(settings);
+        int cells = serial.getCellCount();
+        // Fewer steps for the large grids, the smallest run a few thousand
+        int steps = std::max(4, 4000000 / cells);
+
+        // Warm up: fill the grid with moving gas before timing
+        TimeSteps(serial, nullptr, 60);
+        TimeSteps(parallel, &pool, 60);
+        double serialMs = TimeSteps(serial, nullptr, steps);
+        double poolMs = TimeSteps(parallel, &pool, steps);
+
+        char grid[32];
+        std::snprintf(grid, sizeof(grid), "%dx%dx%d", size[0], size[1], size[2]);
+        std::printf("%-12s %9d %12.3f %12.3f %8.2fx %12.1f\n", grid, cells, serialMs, poolMs,
+                    serialMs / poolMs, poolMs * 1e6 / cells);
+    }
+    return 0;
+}
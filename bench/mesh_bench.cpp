@@ -0,0 +1,69 @@
+// Mesh optimization benchmark: generates every candle LOD, runs the optimizer passes
+// and reports vertex counts, index size and ACMR (FIFO cache 16 and 32) before and after,
+// then times raw generation of many candle variants.
+// No GL context needed.
+//
+// g++ -O2 -std=c++17 bench/mesh_bench.cpp src/CandleMesh.cpp src/MeshOptimizer.cpp -Iinclude -o mesh_bench
+
+#include "CandleMesh.h"
+#include "MeshOptimizer.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+int main() {
+    CandleParams params;
+    int lodSegments[] = {64, 24, 8};
+
+    std::printf("%-8s %-10s %8s %8s %10s %10s %10s\n",
+                "segments", "stage", "verts", "tris", "idx bytes", "ACMR(16)", "ACMR(32)");
+
+    for (int segments : lodSegments) {
+        int wickSegments = segments / 8 > 3 ? segments / 8 : 3;
+        MeshData mesh = generateCandleMesh(params, segments, wickSegments);
+
+        auto report = [&](const char *stage, bool shortIndices) {
+            size_t indexBytes = mesh.indices.size() * (shortIndices ? 2 : 4);
+            std::printf("%-8d %-10s %8d %8d %10zu %10.3f %10.3f\n",
+                        segments, stage, mesh.vertexCount(), (int)(mesh.indices.size() / 3), indexBytes,
+                        computeACMR(mesh.indices, mesh.vertexCount(), 16),
+                        computeACMR(mesh.indices, mesh.vertexCount(), 32));
+        };
+
+        report("generated", false);
+
+        const int iterations = 1000;
+        auto start = std::chrono::high_resolution_clock::now();
+        MeshData optimized;
+        for (int i = 0; i < iterations; i++) {
+            optimized = mesh;
+            optimizeMesh(optimized);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        mesh = optimized;
+
+        report("optimized", fitsShortIndices(mesh.vertexCount()));
+        std::printf("%-8d optimizeMesh: %.2f us/mesh\n\n", segments,
+                    std::chrono::duration<double, std::micro>(end - start).count() / iterations);
+    }
+
+    // Generation cost on its own: many candle variants written into one reused buffer
+    const int variants = 10000;
+    int vertexCount, indexCount;
+    getCandleMeshSize(64, 8, vertexCount, indexCount);
+    std::vector<float> vertices((size_t)vertexCount * 6);
+    std::vector<unsigned int> indices(indexCount);
+    float checksum = 0.0f;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < variants; i++) {
+        CandleParams variant = params;
+        variant.radius = 0.15f + 0.1f * (float)(i % 100) / 100.0f;
+        variant.height = 0.6f + 0.8f * (float)(i % 37) / 37.0f;
+        generateCandleMesh(variant, 64, 8, vertices.data(), indices.data(), 0);
+        checksum += vertices[i % vertices.size()];
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::printf("generateCandleMesh(64 segments): %.3f us/variant over %d variants (checksum %.3f)\n",
+                std::chrono::duration<double, std::micro>(end - start).count() / variants, variants, checksum);
+    return 0;
+}
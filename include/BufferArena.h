@@ -0,0 +1,100 @@
+#ifndef BUFFER_ARENA_H
+#define BUFFER_ARENA_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <map>
+#include <vector>
+#include "MeshData.h"
+
+// Offset allocator over a linear range, first fit with coalescing on free.
+class RangeAllocator {
+public:
+    explicit RangeAllocator(size_t capacity = 0);
+    bool allocate(size_t size, size_t alignment, size_t &offset);
+    void free(size_t offset, size_t size);
+    void grow(size_t newCapacity);
+    size_t getCapacity() const { return capacity; }
+    size_t getUsed() const { return used; }
+
+private:
+    size_t capacity;
+    size_t used;
+    std::map<size_t, size_t> freeRanges; // offset -> size
+};
+
+// A mesh living inside the arena. baseVertex/indexOffset feed glDrawElementsBaseVertex.
+struct ArenaMesh {
+    int format = -1;
+    GLint baseVertex = 0;
+    size_t vertexCount = 0;
+    size_t indexOffset = 0;     // bytes into the shared index buffer
+    size_t indexBytes = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+
+    GLsizei indexCount() const { return (GLsizei)(indexBytes / (indexType == GL_UNSIGNED_SHORT ? 2 : 4)); }
+};
+
+// A dynamic vertex range for per-frame data (particles). Drawn with glDrawArrays from firstVertex.
+struct ArenaStream {
+    int format = -1;
+    GLint firstVertex = 0;
+    size_t vertexCapacity = 0;
+};
+
+// Central GPU buffer suballocator.
+// Every vertex format gets one large VBO and one VAO; all static meshes share a single index
+// buffer. Meshes are placed at offsets and drawn with base-vertex draws, so switching between
+// meshes of the same format needs no VAO or buffer rebinding at all.
+class BufferArena {
+public:
+    BufferArena(size_t vertexBytesPerFormat = 1 << 20, size_t indexBytes = 1 << 19);
+    ~BufferArena();
+    BufferArena(const BufferArena &) = delete;
+    BufferArena &operator=(const BufferArena &) = delete;
+
+    // Copies vertex and index data into the arena. indexSize is 2 or 4 bytes.
+    ArenaMesh allocateMesh(const VertexLayout &layout, const void *vertices, size_t vertexCount,
+                           const void *indices, size_t indexCount, unsigned int indexSize);
+    void freeMesh(ArenaMesh &mesh);
+
+    // Reserves room for vertexCapacity vertices in a GL_DYNAMIC_DRAW buffer for this layout.
+    ArenaStream allocateStream(const VertexLayout &layout, size_t vertexCapacity);
+    void updateStream(const ArenaStream &stream, const void *vertices, size_t vertexCount);
+    void freeStream(ArenaStream &stream);
+
+    // Draws indexCount indices starting at firstIndex of the mesh.
+    void drawElements(const ArenaMesh &mesh, GLenum mode, GLsizei indexCount, size_t firstIndex = 0);
+    void drawArrays(const ArenaStream &stream, GLenum mode, GLsizei vertexCount);
+
+    // Binds the shared VAO of a format, skipping the call if it is already bound.
+    void bindFormat(int format);
+    // Call after binding a VAO outside the arena, so the next bindFormat() rebinds.
+    void invalidateBinding() { boundFormat = -1; }
+
+    int getFormatCount() const { return (int)formats.size(); }
+    size_t getVertexBytesUsed() const;
+    size_t getIndexBytesUsed() const { return indexAllocator.getUsed(); }
+
+private:
+    struct Format {
+        VertexLayout layout;
+        GLenum usage;
+        GLuint VAO;
+        GLuint VBO;
+        RangeAllocator allocator; // in vertices
+    };
+
+    int findOrCreateFormat(const VertexLayout &layout, GLenum usage);
+    void growVertexBuffer(Format &format, size_t minVertices);
+    void growIndexBuffer(size_t minBytes);
+    void setupAttributes(const Format &format);
+
+    std::vector<Format> formats;
+    size_t initialVertexBytes;
+    GLuint EBO;
+    RangeAllocator indexAllocator; // in bytes
+    int boundFormat;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef CANDLE_MESH_H
+#define CANDLE_MESH_H
+
+#include "MeshData.h"
+
+// Shape parameters for a procedural candle (model space, before scaling).
+struct CandleParams {
+    float radius = 0.2f;
+    float height = 1.0f;
+    float innerRadiusRatio = 0.7f; // inner top ring radius as a fraction of radius
+    float dipDepth = 0.05f;        // inner top ring sits this far below the rim
+    float centerDip = 0.01f;       // center vertex sits this far below the inner ring
+    float wickRadius = 0.002f;
+    float wickHeight = 0.05f;
+};
+
+// cos/sin of i/segments * 2pi for i in [0, segments]. Entries for 64, 24, 8 and 3 segments
+// are computed at compile time, other counts once on first use. The pointers stay valid.
+struct RingTable {
+    int segments;
+    const float *cosTable;
+    const float *sinTable;
+};
+RingTable getRingTable(int segments);
+
+// Exact vertex/index counts of a candle mesh, so callers can size buffers up front.
+void getCandleMeshSize(int segments, int wickSegments, int &vertexCount, int &indexCount);
+
+// Builds one candle mesh: cylindrical side, dipped top and a thin wick.
+// Vertex format: position (3), normal (3).
+// Writes straight into caller-provided storage sized with getCandleMeshSize(); indices are offset by baseVertex.
+void generateCandleMesh(const CandleParams &params, int segments, int wickSegments,
+                        float *vertices, unsigned int *indices, unsigned int baseVertex);
+MeshData generateCandleMesh(const CandleParams &params, int segments, int wickSegments);
+
+#endif
@@ -2,16 +2,38 @@
 #define CANDLE_MODEL_H
 
 #include <GL/glew.h>
+#include <vector>
+#include "BufferArena.h"
+#include "CandleMesh.h"
+
+// One tessellation level of the candle. All levels share a single arena allocation.
+struct CandleLod {
+    int segments;
+    int wickSegments;
+    int indexOffset;   // first index of this level inside the candle's index range
+    int indexCount;
+};
 
 class CandleModel {
 public:
-    CandleModel();
+    // lodSegments lists the body segment counts from finest to coarsest.
+    explicit CandleModel(BufferArena &arena, const CandleParams &params = CandleParams(),
+                         const std::vector<int> &lodSegments = {64, 24, 8});
     ~CandleModel();
-    void draw();
+
+    void draw(int lod = 0);
+
+    // Picks the coarsest level whose silhouette error stays under maxErrorPixels,
+    // given the candle's projected radius on screen.
+    int selectLod(float projectedRadiusPixels, float maxErrorPixels = 0.5f) const;
+    int lodCount() const { return (int)lods.size(); }
+    const CandleParams &getParams() const { return params; }
 
 private:
-    GLuint VAO, VBO, EBO;
-    int indexCount;
+    BufferArena &arena;
+    ArenaMesh mesh;
+    CandleParams params;
+    std::vector<CandleLod> lods;
 };
 
 #endif
@@ -0,0 +1,41 @@
+#ifndef CURL_NOISE_H
+#define CURL_NOISE_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ThreadPool.h"
+
+struct CurlNoiseSettings {
+    int resolution = 32;    // grid cells per side of the tile
+    int period = 4;         // noise lattice cells per tile at the first octave
+    int octaves = 2;        // each one doubles the frequency and halves the amplitude
+    uint32_t seed = 1337;
+};
+
+// Divergence free turbulence for the particles.
+// The velocity is the curl of a vector potential made of three periodic gradient noises, so
+// the field has no sources or sinks and particles swirl instead of clumping. It is evaluated
+// once onto a resolution^3 grid (potential, then central differences with wrap-around, on the
+// pool over z slices) and cached on disk; afterwards every lookup is a trilinear blend of 8 cells.
+// The field tiles: coordinates are in tiles, sample(p) == sample(p + integer offset).
+// Velocities are normalized to an RMS magnitude of 1.
+class CurlNoiseField {
+public:
+    // Loads the grid from the cache, or builds and caches it
+    CurlNoiseField(ThreadPool &pool, const CurlNoiseSettings &settings = CurlNoiseSettings());
+
+    glm::vec3 sample(const glm::vec3 &p) const;
+    // Batch form for the particle update: count points in structure-of-arrays form
+    void sample(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz, int count) const;
+
+    int getResolution() const { return resolution; }
+
+private:
+    void build(ThreadPool &pool, const CurlNoiseSettings &settings);
+
+    int resolution;
+    std::vector<float> velocity; // xyz per cell, x fastest
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "LightClusters.h"
+#include "Shader.h"
+#include "ShadowAtlas.h"
+
+// Deferred shading path.
+// The geometry pass writes the room and candle materials into a small G-buffer:
+//   attachment 0  RGBA8    albedo (room texture or candle color)
+//   attachment 1  RGBA16F  world normal, material id in w (see shaders/material_lighting.glsl)
+//   attachment 2  RGBA16F  baked light from the room lightmap, alpha 1 where it applies
+//   depth         DEPTH24_STENCIL8, world positions are rebuilt from it
+// The lighting pass is one full-screen triangle that walks each pixel's light cluster, so the
+// per-light cost no longer depends on how much geometry overlaps that pixel.
+class DeferredRenderer {
+public:
+    DeferredRenderer(int width, int height);
+    ~DeferredRenderer();
+    DeferredRenderer(const DeferredRenderer &) = delete;
+    DeferredRenderer &operator=(const DeferredRenderer &) = delete;
+
+    // Reallocates the G-buffer when the framebuffer size changed
+    void resize(int width, int height);
+
+    // Binds and clears the G-buffer. Draw the scene with the geometry shaders below afterwards.
+    void beginGeometryPass();
+
+    // Lights the G-buffer into targetFramebuffer, then copies the depth over so later forward
+    // passes (particles) still depth test against the scene. Binds its own VAO.
+    void lightingPass(const LightClusters &clusters, const glm::mat4 &view, const glm::mat4 &proj,
+                      const glm::vec3 &viewPos, const ShadowAtlas &shadows, GLuint targetFramebuffer);
+
+    const Shader &getRoomShader() const { return roomShader; }
+    const Shader &getCandleShader() const { return candleShader; }
+
+private:
+    void createTargets();
+    void destroyTargets();
+
+    int width, height;
+    GLuint FBO;
+    GLuint albedoTexture, normalTexture, bakedTexture, depthTexture;
+    GLuint emptyVAO; // the full-screen triangle comes from gl_VertexID
+
+    Shader roomShader;
+    Shader candleShader;
+    Shader lightingShader;
+};
+
+#endif
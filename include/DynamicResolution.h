@@ -0,0 +1,43 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+struct DynamicResolutionSettings {
+    float targetMs = 1000.0f / 60.0f;
+    float minScale = 0.5f;       // per axis, relative to the output size
+    float maxScale = 1.0f;
+    float step = 0.05f;          // the scale moves in steps so the targets are not reallocated every frame
+    float lowerAbove = 0.95f;    // fraction of the budget where resolution goes down
+    float raiseBelow = 0.75f;    // and where it goes back up
+    float smoothing = 0.1f;      // exponential moving average factor for the frame times
+    int cooldownFrames = 15;     // frames to wait after a change, the GPU times lag a few frames behind
+};
+
+// Frame time controller for the internal render resolution.
+// Fed the measured GPU and CPU time of every frame, it lowers the render scale while the GPU
+// goes over budget and raises it again when there is headroom. When the CPU alone is over
+// budget a lower resolution would not help, so the scale is left where it is.
+class DynamicResolution {
+public:
+    explicit DynamicResolution(const DynamicResolutionSettings &settings = DynamicResolutionSettings());
+
+    // Returns true when the scale changed. gpuMs < 0 means no new GPU sample this frame.
+    bool update(double gpuMs, double cpuMs);
+    void reset();
+
+    float getScale() const { return scale; }
+    // Output size -> render size, never below one pixel
+    int scaledSize(int outputSize) const;
+
+    double getGpuMs() const { return gpuMs; }
+    double getCpuMs() const { return cpuMs; }
+    DynamicResolutionSettings &getSettings() { return settings; }
+
+private:
+    DynamicResolutionSettings settings;
+    float scale;
+    double gpuMs, cpuMs;    // smoothed
+    bool hasSamples;
+    int cooldown;
+};
+
+#endif
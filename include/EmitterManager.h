@@ -0,0 +1,62 @@
+#ifndef EMITTER_MANAGER_H
+#define EMITTER_MANAGER_H
+
+#include <vector>
+#include "ParticleEmitter.h"
+
+struct EmitterLodSettings {
+    int particleBudget = 12000;         // live particles over all emitters
+    float fullDetailSize = 160.0f;      // projected radius in pixels from which an emitter gets full detail
+    float minDetail = 0.1f;             // smallest fraction of rate and particles an emitter in view gets
+    float lowDetailTickRate = 20.0f;    // Hz at minDetail, full detail updates every step
+    float hiddenTickRate = 2.0f;        // Hz out of view
+    float warmupTime = 1.5f;            // replayed when an emitter comes into view, one haze lifetime
+    float warmupStep = 1.0f / 30.0f;
+};
+
+// Level of detail for the particle emitters. Runs on the simulation side and does all the
+// emitting and updating:
+//   detail = projected size / fullDetailSize, clamped to [minDetail, 1]
+//   emission rate and particle limit scale with the detail, small flames update less often
+//   emitters out of view tick at hiddenTickRate (their stats stay roughly alive) and are
+//   resynced when they come back: cleared and replayed for warmupTime in warmupStep steps
+//   when the limits add up to more than particleBudget, all limits scale down evenly, so the
+//   live count can never go over it
+// Lowering a limit kills the oldest particles above it right away (setParticleLimit).
+class EmitterManager {
+public:
+    explicit EmitterManager(const EmitterLodSettings &settings = EmitterLodSettings());
+
+    // emissionRate is in particles per second at full detail. Returns the emitter's index.
+    int add(ParticleEmitter *emitter, float emissionRate);
+    // Projected radius in pixels, 0 when out of view. Until set, an emitter counts as full size.
+    void setScreenSize(int index, float projectedRadius);
+    void update(float dt);
+    // Forgets screen sizes, tick timing and visibility, as if every emitter was just added
+    void reset();
+
+    bool isVisible(int index) const { return entries[index].screenSize > 0.0f; }
+    float getDetail(int index) const { return entries[index].detail; }
+    int getLiveParticles() const;
+    float getBudgetScale() const { return budgetScale; }
+    EmitterLodSettings &getSettings() { return settings; }
+
+private:
+    struct Entry {
+        ParticleEmitter *emitter;
+        float emissionRate;
+        float screenSize;
+        float detail;
+        float carry;        // fractional particles left over from the last tick
+        float pending;      // time since the last tick
+        bool wasVisible;
+    };
+
+    void tick(Entry &entry, float rate, float dt);
+
+    EmitterLodSettings settings;
+    std::vector<Entry> entries;
+    float budgetScale;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef FLAME_FLUID_H
+#define FLAME_FLUID_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ThreadPool.h"
+
+struct FluidSettings {
+    int sizeX = 16;                 // grid cells, y is up
+    int sizeY = 32;
+    int sizeZ = 16;
+    float cellSize = 0.025f;        // world units per cell
+    int pressureIterations = 20;    // Jacobi sweeps per step, warm started from the last step
+    float buoyancy = 150.0f;        // upward acceleration per unit temperature, cells/s^2
+    float smokeWeight = 4.0f;       // downward acceleration per unit density
+    float cooling = 3.0f;           // temperature decay per second
+    float smokeFade = 0.6f;         // density decay per second
+    float sourceRadius = 2.0f;      // cells, the burning zone around the wick
+    float sourceHeight = 3.0f;      // cells above the bottom of the grid
+    float sourceSpeed = 20.0f;      // cells/s, upward push of the burning zone
+    float flicker = 6.0f;           // cells/s, random sideways drift of the burning zone
+    float flickerRate = 4.0f;       // 1/s, how fast that drift changes
+    uint32_t seed = 7;
+};
+
+// Small Eulerian flame and smoke simulation on a bounded grid around one wick.
+// Stable fluids on a collocated grid: forces (buoyancy from temperature, weight from smoke),
+// semi-Lagrangian advection of the velocity, pressure projection by Jacobi iterations, then
+// advection of smoke density and temperature. Velocities are in cells per second. Every field
+// carries one ghost cell per side so the stencils never branch; the floor is closed, the other
+// faces let the gas out.
+// step() with a pool splits every pass over z slabs (for large grids); without one it runs on
+// the calling thread, the way to step many small grids in parallel. The Jacobi sweep is SSE.
+class FlameFluid {
+public:
+    explicit FlameFluid(const FluidSettings &settings = FluidSettings());
+
+    void step(float dt, ThreadPool *pool = nullptr);
+    void reset();
+
+    // Density and temperature of every cell, clamped to [0, 1] as RG8 texels, x fastest
+    void writeVolume(std::vector<uint8_t> &texels) const;
+
+    const FluidSettings &getSettings() const { return settings; }
+    glm::vec3 getWorldSize() const;
+    // Wick position relative to the grid's min corner, in world units
+    glm::vec3 getSourceOffset() const;
+    int getCellCount() const { return settings.sizeX * settings.sizeY * settings.sizeZ; }
+
+private:
+    size_t index(int x, int y, int z) const { return ((size_t)z * strideZ) + (size_t)y * strideY + x; }
+    // fn(zBegin, zEnd) over the interior slabs, 1-based like the cells
+    template <typename Fn> void forSlabs(ThreadPool *pool, const Fn &fn);
+
+    void addSources(float dt);
+    void applyForces(float dt, ThreadPool *pool);
+    void advect(float dt, const std::vector<float> &src, std::vector<float> &dst, float decay, ThreadPool *pool);
+    void project(ThreadPool *pool);
+
+    void copyBoundary(std::vector<float> &field) const;
+    void verticalVelocityBoundary(std::vector<float> &field) const;
+    void zeroBoundary(std::vector<float> &field) const;
+    void pressureBoundary(std::vector<float> &field) const;
+    float sampleField(const std::vector<float> &field, float x, float y, float z) const;
+
+    FluidSettings settings;
+    int strideY, strideZ;
+    std::vector<float> u, v, w;
+    std::vector<float> density, temperature;
+    std::vector<float> pressure, divergence;
+    std::vector<float> scratch[3];
+    std::mt19937 rng;
+    float windX, windZ; // current drift of the burning zone
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FLAME_LIGHT_H
+#define FLAME_LIGHT_H
+
+#include <glm/glm.hpp>
+#include "ParticleEmitter.h"
+
+struct FlameLightSettings {
+    float liveGain = 0.5f;          // intensity change per relative change of the live count
+    float heightGain = 5.0f;        // intensity change per unit the particles rise above their average
+    float ageGain = 1.5f;           // how much older than usual particles redden the light
+    float followFraction = 0.6f;    // share of the centroid's sideways offset the light follows
+    float maxOffset = 0.08f;        // and at most this far
+    float minIntensity = 0.5f;
+    float maxIntensity = 1.5f;
+    float averageRate = 2.0f;       // 1/s, how fast the running averages follow the stats
+};
+
+// Flickering flame light from the core emitter's stats (see ParticleEmitter::getStats()).
+// The stats come out of the emitter's update pass, so this is a few multiplies per flame on the
+// simulation thread, no extra sweep over the particles and nothing read back from the GPU.
+// Everything is measured against running averages of the same stats, so level of detail changes
+// (fewer particles, fewer updates) shift the averages instead of dimming the light:
+//   intensity  follows the live count and how high the particles' centroid is
+//   color      reddens while the particles are older than usual (a dying, sooty flame)
+//   position   leans toward the centroid's sideways offset from the wick
+class FlameLight {
+public:
+    explicit FlameLight(const FlameLightSettings &settings = FlameLightSettings());
+
+    void update(const EmitterStats &stats, const glm::vec3 &flamePos, float dt);
+
+    glm::vec3 getPosition() const { return position; }
+    float getIntensity() const { return intensity; }
+    // baseColor tinted by the current age
+    glm::vec3 getColor(const glm::vec3 &baseColor) const;
+
+private:
+    FlameLightSettings settings;
+    bool started;
+    float averageLive, averageHeight, averageAge;
+    glm::vec3 position;
+    float intensity;
+    float ageOffset;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef FLAME_VOLUME_H
+#define FLAME_VOLUME_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BufferArena.h"
+#include "Shader.h"
+
+struct FlameVolumeSettings {
+    float sampleBudget = 8.0f;      // million ray samples per frame over all flames
+    float minSampleRate = 0.25f;    // samples per cell the budget can push a flame down to
+    int maxSteps = 96;              // per ray, whatever the rate
+    float opacityCutoff = 0.98f;    // rays stop once this opaque
+    float emptySkip = 3.0f;         // step multiplier through cells with no smoke and no heat
+    float minKelvin = 500.0f;       // blackbody temperature at grid temperature 0
+    float maxKelvin = 1900.0f;      // and at 1, about a candle flame
+    int lutSize = 256;
+};
+
+// Ray-marched flames from the fluid grids (see FlameFluid).
+// Every flame owns an RG8 3D texture (density, temperature) that gets the grid's texels after
+// each simulation step. A flame is drawn as the front faces of its box; the fragment shader
+// marches the view ray through the volume, adds blackbody emission looked up from a 1D texture
+// (Planck spectrum through the CIE matching functions, built at startup) and lets smoke absorb
+// what is behind it, blending over the scene as premultiplied alpha.
+// The march takes longer strides through empty cells and stops once the ray is nearly opaque.
+// Cost is kept bounded with many flames in view: the queued flames' screen footprints (projected
+// box area times the cells a ray crosses) are summed, and when that exceeds the sample budget
+// every flame marches with proportionally fewer samples per cell.
+class FlameVolumeRenderer {
+public:
+    // count volumes of sizeX * sizeY * sizeZ texels
+    FlameVolumeRenderer(BufferArena &arena, int count, int sizeX, int sizeY, int sizeZ,
+                        const FlameVolumeSettings &settings = FlameVolumeSettings());
+    ~FlameVolumeRenderer();
+    FlameVolumeRenderer(const FlameVolumeRenderer &) = delete;
+    FlameVolumeRenderer &operator=(const FlameVolumeRenderer &) = delete;
+
+    // texels as written by FlameFluid::writeVolume()
+    void upload(int index, const std::vector<uint8_t> &texels);
+
+    // Queue the flames of this frame, then render them all. The scene framebuffer (with its
+    // depth) must be bound; blend, depth and cull state are restored afterwards.
+    void clear() { queued.clear(); }
+    void add(int index, const glm::vec3 &boxMin, const glm::vec3 &boxSize);
+    void render(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec3 &cameraPos, const glm::vec2 &screenSize);
+
+    FlameVolumeSettings &getSettings() { return settings; }
+    // Of the last render(): estimated ray samples in millions before the budget, and the
+    // samples per cell it left
+    float getLastCost() const { return lastCost; }
+    float getSampleRate() const { return sampleRate; }
+    int getLastFlameCount() const { return (int)queued.size(); }
+
+private:
+    struct QueuedFlame {
+        int index;
+        glm::vec3 boxMin, boxSize;
+    };
+
+    void buildBlackbodyLut();
+
+    BufferArena &arena;
+    FlameVolumeSettings settings;
+    ArenaMesh box;
+    int sizeX, sizeY, sizeZ;
+    std::vector<GLuint> textures;
+    GLuint blackbodyTexture;
+    Shader shader;
+    std::vector<QueuedFlame> queued;
+    float lastCost, sampleRate;
+};
+
+#endif
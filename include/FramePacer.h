@@ -0,0 +1,73 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+enum class VsyncMode { Off, On, Adaptive };
+
+struct FramePacerSettings {
+    double targetFps = 0.0;              // frame limiter, 0 = off (vsync or nothing paces the loop)
+    VsyncMode vsync = VsyncMode::Adaptive;
+    double spinMs = 1.0;                 // the last bit of every wait spins, sleeps overshoot
+};
+
+// Frame pacing and latency measurement.
+// The limiter sleeps until shortly before each frame's deadline and spins the rest, so frames
+// start on a steady cadence without burning a core. Vsync is set explicitly instead of relying
+// on the driver default; adaptive vsync (swap interval -1, EXT_swap_control_tear) tears only
+// when a frame misses the interval instead of halving the rate.
+// Input-to-present latency: markInput() when input is polled, presented() after the swap. A
+// fence after the swap tells when the GPU finished the frame; it is polled, never waited on,
+// so that time is an upper bound by at most one frame.
+class FramePacer {
+public:
+    explicit FramePacer(const FramePacerSettings &settings = FramePacerSettings());
+    ~FramePacer();
+    FramePacer(const FramePacer &) = delete;
+    FramePacer &operator=(const FramePacer &) = delete;
+
+    // Needs the window's context current. Returns the mode actually in effect.
+    VsyncMode applyVsync();
+
+    // Blocks until the next frame should start (no-op without a target rate)
+    void waitForNextFrame();
+    void markInput();
+    void presented();
+
+    VsyncMode getVsync() const { return activeVsync; }
+    FramePacerSettings &getSettings() { return settings; }
+    // Over the last `LATENCY_HISTORY` frames, in milliseconds
+    double getSwapLatencyMs() const { return average(swapLatencies); }
+    double getPresentLatencyMs() const { return average(presentLatencies); }
+    double getMaxPresentLatencyMs() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static const size_t LATENCY_HISTORY = 120;
+
+    struct PendingFrame {
+        GLsync fence;
+        Clock::time_point input;
+    };
+
+    void sleepUntil(Clock::time_point deadline);
+    static double average(const std::deque<double> &values);
+    static void push(std::deque<double> &values, double value);
+
+    FramePacerSettings settings;
+    VsyncMode activeVsync;
+    Clock::time_point nextDeadline;
+    bool hasDeadline;
+    Clock::time_point inputTime;
+    std::vector<PendingFrame> pending;
+    std::deque<double> swapLatencies, presentLatencies;
+#ifdef _WIN32
+    void *timer;  // high resolution waitable timer
+#endif
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <GL/glew.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Named GPU sections timed with GL_TIMESTAMP queries.
+// Results are read back `latency` frames later, when they are long done, so timing never
+// stalls the pipeline. Sections may nest (timestamps, not GL_TIME_ELAPSED).
+// Every section keeps its last `history` samples for rolling min / average / 99th percentile,
+// and every sample can also be streamed to a CSV (frame,section,ms).
+class GpuTimer {
+public:
+    explicit GpuTimer(int latency = 4, int history = 240);
+    ~GpuTimer();
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    // Call once per frame before any begin(); collects the oldest frame's results.
+    void beginFrame();
+    void begin(const std::string &name);
+    void end(const std::string &name);
+
+    int getSectionCount() const { return (int)sections.size(); }
+    // -1 until the section was first used
+    int findSection(const std::string &name) const;
+    const std::string &getName(int section) const { return sections[section].name; }
+    double getLastMs(int section) const { return sections[section].lastMs; }
+    int getSampleCount(int section) const { return sections[section].samples; }
+    // Over the rolling window
+    double getAverageMs(int section) const;
+    double getMinMs(int section) const;
+    double getPercentileMs(int section, double percentile) const;
+
+    // One line per section: rolling min, average, p99 and the last time in milliseconds
+    void report(std::ostream &out) const;
+
+    // Writes a header now and one line per collected sample from then on. nullptr stops.
+    void setCsvOutput(std::ostream *csv);
+
+private:
+    struct Section {
+        std::string name;
+        double lastMs = 0.0;
+        int samples = 0;
+        std::vector<float> history;    // ring of the last samples
+        size_t historyNext = 0;
+    };
+    struct Pending {
+        int section;
+        GLuint start, end;
+    };
+    struct Frame {
+        std::vector<GLuint> queries;   // pool, grows on demand
+        std::vector<Pending> pending;
+        size_t used = 0;
+        std::vector<int> open;         // section -> index into pending, -1 when not running
+        long long index = 0;           // frame number the queries were issued in
+    };
+
+    int findOrAddSection(const std::string &name);
+    GLuint nextQuery(Frame &frame);
+
+    std::vector<Section> sections;
+    std::vector<Frame> frames;
+    int current;
+    size_t historySize;
+    long long frameIndex;
+    std::ostream *csv;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// What one simulation step consumed: its time step, the movement keys held and the flame mode
+// (InputKey bits, at most 8)
+struct InputStep {
+    float dt = 0.0f;
+    uint32_t keys = 0;
+};
+
+// Binary input log: a header, then runs of identical consecutive steps. Every run stores the
+// step it starts at, how many steps it covers, their dt and key bits (13 bytes), so the usual
+// fixed-rate simulation with keys held for a while takes a few bytes per key change.
+struct InputLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t stepCount;
+    uint64_t runCount;
+};
+
+// Appends steps to a log. The header is rewritten with the final counts on close().
+class InputRecorder {
+public:
+    InputRecorder() = default;
+    ~InputRecorder() { close(); }
+    InputRecorder(const InputRecorder &) = delete;
+    InputRecorder &operator=(const InputRecorder &) = delete;
+
+    bool open(const std::string &path);
+    void record(const InputStep &step);
+    void close();
+    bool isOpen() const { return file.is_open(); }
+    uint64_t getStepCount() const { return stepCount; }
+
+private:
+    void writeRun();
+
+    std::ofstream file;
+    std::string path;
+    InputStep current;
+    uint32_t runStart = 0, runLength = 0;
+    uint64_t stepCount = 0, runCount = 0;
+};
+
+// Reads a whole log and hands the steps back in order.
+class InputPlayer {
+public:
+    bool open(const std::string &path);
+    bool isOpen() const { return opened; }
+    // False once the log is exhausted
+    bool next(InputStep &step);
+    bool isFinished() const { return played >= stepCount; }
+    // Plays the log again from its first step
+    void rewind() { run = 0; stepInRun = 0; played = 0; }
+    uint64_t getStepCount() const { return stepCount; }
+
+private:
+    struct Run {
+        uint32_t firstStep, length;
+        InputStep step;
+    };
+
+    bool opened = false;
+    std::vector<Run> runs;
+    size_t run = 0;
+    uint32_t stepInRun = 0;
+    uint64_t stepCount = 0, played = 0;
+};
+
+#endif
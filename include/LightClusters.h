@@ -0,0 +1,66 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "ThreadPool.h"
+
+struct PointLight {
+    glm::vec3 position;
+    float radius;       // light contributes nothing beyond this distance
+    glm::vec3 color;
+    float intensity;
+    float bakedIntensity = 0.0f; // part of intensity already in the room lightmap
+};
+
+// Clustered forward lighting.
+// The view frustum is split into tilesX * tilesY screen tiles and exponential depth slices.
+// Every frame the CPU bins the lights into those clusters (in parallel over depth slices) and
+// uploads three texture buffers the fragment shaders read through shaders/clustered_lights.glsl:
+//   uLightData     RGBA32F, 2 texels per light: (position, radius), (color * intensity, baked fraction)
+//   uClusterGrid   RG32UI, per cluster: (first index, light count)
+//   uLightIndices  R32UI, light indices of all clusters back to back
+class LightClusters {
+public:
+    LightClusters(ThreadPool &pool, int tilesX = 16, int tilesY = 9, int slices = 24);
+    ~LightClusters();
+    LightClusters(const LightClusters &) = delete;
+    LightClusters &operator=(const LightClusters &) = delete;
+
+    // Bins the lights for this view and uploads the result. near/far must match proj.
+    void update(const std::vector<PointLight> &lights, const glm::mat4 &view, const glm::mat4 &proj,
+                float nearPlane, float farPlane);
+
+    // Binds the texture buffers to three consecutive units starting at firstUnit and sets the uniforms.
+    void bind(const Shader &shader, int firstUnit, const glm::vec2 &screenSize) const;
+
+    int getLightCount() const { return lightCount; }
+    int getIndexCount() const { return indexCount; }
+    int getClusterCount() const { return tilesX * tilesY * slices; }
+
+private:
+    int sliceForDepth(float depth) const;
+
+    ThreadPool &pool;
+    int tilesX, tilesY, slices;
+    float nearPlane, farPlane;
+    float sliceScale;   // slices / log(far / near)
+    int lightCount;
+    int indexCount;
+
+    // Per light, in structure-of-arrays form so the range computations vectorize
+    std::vector<float> viewX, viewY, viewZ, radius;
+    std::vector<int> tileMinX, tileMaxX, tileMinY, tileMaxY, sliceMin, sliceMax;
+
+    std::vector<uint32_t> clusterGrid;    // (offset, count) pairs
+    std::vector<uint32_t> lightIndices;
+    std::vector<float> lightData;
+
+    GLuint lightDataBuffer, clusterGridBuffer, lightIndexBuffer;
+    GLuint lightDataTexture, clusterGridTexture, lightIndexTexture;
+};
+
+#endif
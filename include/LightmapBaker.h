@@ -0,0 +1,59 @@
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "LightClusters.h"
+#include "ThreadPool.h"
+
+// A flat rectangle of static geometry that gets its own square tile in the lightmap.
+// Surface point (u, v) in [0,1]^2 is origin + u * edgeU + v * edgeV.
+struct LightmapFace {
+    glm::vec3 origin;
+    glm::vec3 edgeU;
+    glm::vec3 edgeV;
+    glm::vec3 normal;
+};
+
+// Axis aligned occluder (e.g. a static candle) for the shadow and bounce rays.
+struct LightmapBox {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct LightmapSettings {
+    int faceResolution = 128;       // texels per face side
+    int bounceSamples = 16;         // hemisphere rays per texel for the single indirect bounce
+    glm::vec3 bounceAlbedo = glm::vec3(0.5f);
+    glm::vec3 boundsMin = glm::vec3(-1.0f); // the closed box the bounce rays land on
+    glm::vec3 boundsMax = glm::vec3(1.0f);
+};
+
+// Faces are laid out LIGHTMAP_COLUMNS to a row, face i at column i % LIGHTMAP_COLUMNS.
+const int LIGHTMAP_COLUMNS = 3;
+int lightmapWidth(const LightmapSettings &settings);
+int lightmapHeight(int faceCount, const LightmapSettings &settings);
+
+// Lightmap texture coordinate of surface point (u, v) of a face. Maps the face onto texel
+// centers so bilinear filtering never reads a neighbouring tile.
+glm::vec2 lightmapCoord(int face, int faceCount, float u, float v, const LightmapSettings &settings);
+
+// Path traces the diffuse lighting of the static lights: direct light with shadow rays plus
+// one bounce off the enclosing box. Work is split into 16x16 texel tiles over the pool.
+// Returns RGB irradiance, lightmapWidth() x lightmapHeight() texels, bottom row first. The
+// shader multiplies it with the surface albedo.
+std::vector<float> bakeLightmap(ThreadPool &pool, const std::vector<LightmapFace> &faces,
+                                const std::vector<PointLight> &lights, const std::vector<LightmapBox> &occluders,
+                                const LightmapSettings &settings);
+
+// Cache key over everything the bake depends on
+uint64_t lightmapKey(const std::vector<LightmapFace> &faces, const std::vector<PointLight> &lights,
+                     const std::vector<LightmapBox> &occluders, const LightmapSettings &settings);
+
+// Binary cache file: small header followed by the float texels.
+bool readLightmapFile(const std::string &path, uint64_t key, int width, int height, std::vector<float> &texels);
+bool writeLightmapFile(const std::string &path, uint64_t key, int width, int height, const std::vector<float> &texels);
+
+#endif
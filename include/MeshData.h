@@ -0,0 +1,29 @@
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+#include <vector>
+
+// One float vertex attribute: shader location, component count and byte offset in the vertex.
+struct VertexAttribute {
+    unsigned int location;
+    unsigned int components;
+    unsigned int offset;
+};
+
+// Interleaved vertex layout shared by a mesh's VBO and its VAO setup.
+struct VertexLayout {
+    unsigned int stride = 0; // bytes
+    std::vector<VertexAttribute> attributes;
+};
+
+// CPU-side geometry produced by the procedural generators.
+// Vertices are interleaved floats, floatsPerVertex wide.
+struct MeshData {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    int floatsPerVertex = 0;
+
+    int vertexCount() const { return floatsPerVertex ? (int)(vertices.size() / floatsPerVertex) : 0; }
+};
+
+#endif
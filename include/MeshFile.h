@@ -0,0 +1,103 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// Binary mesh format (.mesh), used both for meshes shipped on disk and for the
+// procedural geometry cache. Layout, all little-endian:
+//
+//   MeshFileHeader
+//   MeshFileAttribute[attributeCount]
+//   MeshFileRange[rangeCount]
+//   vertex data   (at vertexDataOffset, vertexCount * vertexStride bytes)
+//   index data    (at indexDataOffset, indexCount * indexSize bytes)
+//
+// Loading maps the file and hands out pointers into it, so the data can go straight to glBufferData.
+
+const uint32_t MESH_FILE_MAGIC = 0x48534D43; // "CMSH"
+const uint32_t MESH_FILE_VERSION = 1;
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;              // hash of the generator parameters, 0 for authored meshes
+    uint32_t vertexCount;
+    uint32_t vertexStride;     // bytes
+    uint32_t indexCount;
+    uint32_t indexSize;        // 2 or 4 bytes
+    uint32_t attributeCount;
+    uint32_t rangeCount;
+    uint32_t vertexDataOffset;
+    uint32_t indexDataOffset;
+};
+
+struct MeshFileAttribute {
+    uint32_t location;
+    uint32_t components;       // floats
+    uint32_t offset;           // bytes into the vertex
+    uint32_t reserved;
+};
+
+// A sub-range of the index buffer, e.g. one LOD. tag is up to the producer.
+struct MeshFileRange {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t tag;
+    uint32_t reserved;
+};
+
+// Read-only memory-mapped .mesh file.
+class MeshFile {
+public:
+    MeshFile();
+    ~MeshFile();
+    MeshFile(const MeshFile &) = delete;
+    MeshFile &operator=(const MeshFile &) = delete;
+
+    // Maps and validates the file. If expectedKey is non-zero the stored key must match.
+    bool open(const std::string &path, uint64_t expectedKey = 0);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    const MeshFileHeader &getHeader() const { return *header; }
+    VertexLayout getLayout() const;
+    std::vector<MeshFileRange> getRanges() const;
+    const void *vertexData() const { return base + header->vertexDataOffset; }
+    const void *indexData() const { return base + header->indexDataOffset; }
+    size_t vertexDataSize() const { return (size_t)header->vertexCount * header->vertexStride; }
+    size_t indexDataSize() const { return (size_t)header->indexCount * header->indexSize; }
+
+private:
+    const unsigned char *base;
+    size_t size;
+    const MeshFileHeader *header;
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#endif
+};
+
+// Writes a .mesh file. indexSize must be 2 (indices are narrowed) or 4.
+bool writeMeshFile(const std::string &path, uint64_t key, const VertexLayout &layout,
+                   const MeshData &mesh, unsigned int indexSize,
+                   const std::vector<MeshFileRange> &ranges);
+
+// FNV-1a over raw bytes, chainable through seed. Used to key cached meshes on their parameters.
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+// cache/<name>_<key as hex>.mesh; creates the cache directory if needed.
+std::string meshCachePath(const std::string &name, uint64_t key);
+// Same naming for other cached assets: cache/<name>_<key in hex>.<extension>
+std::string cacheFilePath(const std::string &name, uint64_t key, const std::string &extension);
+
+// Other cached assets are a header (magic, version, key, sizes; no padding bytes) followed by
+// one blob. Reading fails, quietly unless the file is truncated, when the stored header differs
+// from header in any byte. Writing goes through a temporary name like writeMeshFile().
+bool readCacheFile(const std::string &path, const void *header, size_t headerSize, void *blob, size_t blobSize);
+bool writeCacheFile(const std::string &path, const void *header, size_t headerSize, const void *blob, size_t blobSize);
+
+#endif
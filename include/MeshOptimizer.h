@@ -0,0 +1,34 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "MeshData.h"
+#include <vector>
+
+// Post-processing passes for the procedural meshes, run once at load time.
+// Typical order: weld -> vertex cache -> overdraw -> vertex fetch (optimizeMesh does all four).
+
+// Merges vertices whose attributes all match within epsilon and drops triangles that collapse.
+void weldVertices(MeshData &mesh, float epsilon = 1e-5f);
+
+// Reorders triangles for the post-transform vertex cache (Tipsify, Sander et al. 2007).
+void optimizeVertexCache(MeshData &mesh, int cacheSize = 16);
+
+// Reorders the cache-friendly triangle clusters so outward facing ones draw first.
+// A cluster order is only kept if ACMR grows by less than the given threshold factor.
+void optimizeOverdraw(MeshData &mesh, float threshold = 1.05f, int cacheSize = 16);
+
+// Renumbers vertices in first-use order so vertex fetches walk memory linearly.
+// Unreferenced vertices are dropped.
+void optimizeVertexFetch(MeshData &mesh);
+
+// Runs all of the above with the default settings.
+void optimizeMesh(MeshData &mesh);
+
+// Average cache miss ratio: transformed vertices per triangle for a FIFO cache of cacheSize.
+// 3.0 is the worst case, ~0.5-0.7 is what a good order reaches on regular grids.
+float computeACMR(const std::vector<unsigned int> &indices, int vertexCount, int cacheSize = 16);
+
+// True if every index fits in GL_UNSIGNED_SHORT.
+inline bool fitsShortIndices(int vertexCount) { return vertexCount <= 65536; }
+
+#endif
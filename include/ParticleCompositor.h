@@ -0,0 +1,51 @@
+#ifndef PARTICLE_COMPOSITOR_H
+#define PARTICLE_COMPOSITOR_H
+
+#include <GL/glew.h>
+#include "Shader.h"
+
+// Reduced resolution particle rendering.
+// Additive flame sprites overlap heavily, so their fill cost dominates with many candles in
+// view. Drawing them at 1/downscale resolution in both axes cuts that by downscale^2:
+//   begin()      downsamples the scene depth (farthest of each block) into the low-res
+//                target's depth buffer and clears its color
+//   (draw the particles, point sizes scaled by getPointScale(), no depth writes)
+//   composite()  upsamples with a bilateral filter (bilinear weights times depth similarity
+//                against the full-res depth) and adds the result onto the scene, or blends it
+//                over the scene when the particles were alpha blended (premultiplied)
+class ParticleCompositor {
+public:
+    ParticleCompositor(int width, int height, int downscale = 2);
+    ~ParticleCompositor();
+    ParticleCompositor(const ParticleCompositor &) = delete;
+    ParticleCompositor &operator=(const ParticleCompositor &) = delete;
+
+    // Full resolution size; reallocates when it changed
+    void resize(int width, int height);
+
+    // Leaves the low-res target bound with its viewport and depth writes off
+    void begin(GLuint sceneDepthTexture);
+    // Adds the particles onto sceneColorFramebuffer (which must not have the depth attached).
+    // premultiplied: the particles were drawn with alpha blending into the cleared target
+    // (color over, alpha accumulated as coverage) and go over the scene instead.
+    // Restores the full-res viewport and depth writes. Binds its own VAO.
+    void composite(GLuint sceneColorFramebuffer, GLuint sceneDepthTexture, float nearPlane, float farPlane,
+                   bool premultiplied = false);
+
+    float getPointScale() const { return 1.0f / downscale; }
+
+private:
+    void createTargets();
+    void destroyTargets();
+
+    int width, height;
+    int downscale;
+    int lowWidth, lowHeight;
+    GLuint FBO, colorTexture, depthTexture;
+    GLuint emptyVAO;
+
+    Shader depthDownsampleShader;
+    Shader compositeShader;
+};
+
+#endif
@@ -2,8 +2,14 @@
 #define PARTICLE_EMITTER_H
 
 #include <GL/glew.h>
+#include <algorithm>
+#include <cstdint>
+#include <random>
 #include <vector>
 #include <glm/glm.hpp>
+#include "BufferArena.h"
+
+class CurlNoiseField;
 
 struct Particle {
     glm::vec3 position;
@@ -12,6 +18,13 @@ struct Particle {
     float size;
 };
 
+// Aggregates over the live particles, gathered by update() in its particle pass
+struct EmitterStats {
+    int liveCount = 0;
+    glm::vec3 centroid = glm::vec3(0.0f); // the emission position while nothing is alive
+    float meanAge = 0.0f;                 // fraction of the lifespan, 0 = just born
+};
+
 enum class EmitterType {
     CoreFlame,
     HeatHaze
@@ -19,20 +32,59 @@ enum class EmitterType {
 
 class ParticleEmitter {
 public:
-    ParticleEmitter(int maxParticles, EmitterType type);
+    ParticleEmitter(BufferArena &arena, int maxParticles, EmitterType type);
+    ~ParticleEmitter();
 
+    // Simulation side
     void update(float dt);
-    void draw();
     void emit(int count);
     void setEmissionPosition(const glm::vec3 &pos) { emissionPosition = pos; }
+    // emit() stops spawning while this many particles are alive (clamped to maxParticles).
+    // A lower limit than the live count kills the oldest particles, the ones closest to dying.
+    void setParticleLimit(int limit);
+    // Drift from a curl noise field (shared, read only) instead of white noise: strength in
+    // units per second, scale in field tiles per unit. nullptr switches back to the random drift.
+    void setTurbulence(const CurlNoiseField *field, float strength, float scale);
+    // Restarts the emitter's own random sequence; equal seeds and inputs give equal particles
+    void setSeed(uint32_t seed) { rng.seed(seed); }
+    // Kills every particle
+    void clear();
+    // Back to the state after construction with this seed: no particles, turbulence time 0
+    void restart(uint32_t seed);
+    int getLiveCount() const { return liveCount; }
+    int getMaxParticles() const { return maxParticles; }
+    // Of the last update()
+    const EmitterStats &getStats() const { return stats; }
+    // Replaces out with the live particle positions (x, y, z)
+    void writePositions(std::vector<float> &out) const;
+
+    // Render side: uploads and draws positions from writePositions(). Touches no particle
+    // state, so it may run while the simulation thread updates the emitter.
+    void draw(const std::vector<float> &positions);
+
+    // Vertex format of the particle streams, positions only
+    static VertexLayout vertexLayout();
 
 private:
     std::vector<Particle> particles;
     int maxParticles;
+    int particleLimit;
+    int liveCount;
 
-    GLuint VAO, VBO;
+    BufferArena &arena;
+    ArenaStream stream;
     glm::vec3 emissionPosition;
     EmitterType emitterType;
+    float lifeSpan;
+    EmitterStats stats;
+
+    const CurlNoiseField *turbulence;
+    float turbulenceStrength;
+    float turbulenceScale;
+    float time;
+    std::mt19937 rng;
+
+    float randomRange(float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); }
 };
 
 #endif
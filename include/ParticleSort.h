@@ -0,0 +1,36 @@
+#ifndef PARTICLE_SORT_H
+#define PARTICLE_SORT_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ThreadPool.h"
+
+// Back to front ordering of particles for alpha blending.
+// View depths are quantized to 16 bit keys over the frame's depth range, then a parallel LSD
+// radix sort (two 8 bit digits) orders the keys together with the particle indices. Only the
+// 6 byte key/index pairs move, the caller gathers its particle data through the order.
+// Every pass splits the particles into fixed blocks: per block histograms, one prefix sum over
+// (digit, block), then each block scatters its own range, which keeps the sort stable.
+class ParticleSorter {
+public:
+    explicit ParticleSorter(ThreadPool &pool);
+
+    // positions are count (x, y, z) triples. Returns the indices, farthest from the camera first.
+    const std::vector<uint32_t> &sort(const float *positions, int count, const glm::mat4 &view);
+    const std::vector<uint32_t> &getOrder() const { return indices; }
+
+private:
+    // One radix pass over the byte at shift: src -> dst, histograms must hold the block counts
+    void scatter(const uint16_t *srcKeys, const uint32_t *srcIndices, uint16_t *dstKeys, uint32_t *dstIndices,
+                 int count, int shift);
+
+    ThreadPool &pool;
+    std::vector<float> depths;
+    std::vector<float> blockMin, blockMax;
+    std::vector<uint16_t> keys, keysTemp;
+    std::vector<uint32_t> indices, indicesTemp;
+    std::vector<uint32_t> histograms; // 256 counters per block
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include "GpuTimer.h"
+#include "Shader.h"
+
+struct BloomSettings {
+    float threshold = 1.0f;   // HDR brightness where bloom starts
+    float knee = 0.5f;        // soft transition below the threshold
+    float strength = 0.08f;
+    float exposure = 1.0f;
+    int maxLevels = 6;
+    float sharpness = 0.5f;   // upscale sharpening when rendering below the output resolution
+};
+
+// HDR scene target plus the resolve to the screen.
+// The scene renders into an RGBA16F color / DEPTH24_STENCIL8 target (same depth format as the
+// G-buffer, so the deferred path can blit into it). resolve() then builds bloom with a dual
+// filter chain: a thresholded 4+1 tap downsample to 1/2, 1/4, ... resolution, and 8 tap
+// upsamples added back up the chain. Finally a filmic (ACES fit) tonemap writes the screen.
+// With dynamic resolution the scene target is smaller than the output: the tonemap then goes
+// into an LDR target of the render size and a sharpening upscale writes the output.
+// Every pass is timed through the GpuTimer under its own name.
+class PostProcess {
+public:
+    PostProcess(int width, int height, const BloomSettings &settings = BloomSettings());
+    ~PostProcess();
+    PostProcess(const PostProcess &) = delete;
+    PostProcess &operator=(const PostProcess &) = delete;
+
+    // Render resolution of the scene, the output size is given to resolve()
+    void resize(int width, int height);
+
+    // Binds and clears the HDR target
+    void beginScene(const glm::vec4 &clearColor);
+    GLuint getSceneFramebuffer() const { return sceneFBO; }
+    // Color only, for passes that add onto the scene while sampling its depth texture
+    GLuint getSceneColorFramebuffer() const { return sceneColorFBO; }
+    GLuint getSceneDepthTexture() const { return sceneDepth; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Bloom and tonemap into outputFramebuffer, upscaling when the output is larger than the
+    // scene target. Binds its own VAO.
+    void resolve(GpuTimer &timer, GLuint outputFramebuffer, int outputWidth, int outputHeight);
+
+    BloomSettings &getSettings() { return settings; }
+
+private:
+    struct BloomLevel {
+        GLuint texture, FBO;
+        int width, height;
+        std::string downName, upName;
+    };
+
+    void createTargets();
+    void destroyTargets();
+    void drawFullscreen();
+
+    int width, height;
+    BloomSettings settings;
+    GLuint sceneFBO, sceneColorFBO, sceneColor, sceneDepth;
+    GLuint ldrFBO, ldrColor;   // tonemapped, before the upscale
+    std::vector<BloomLevel> levels;
+    GLuint emptyVAO;
+
+    Shader downsampleShader;
+    Shader upsampleShader;
+    Shader tonemapShader;
+    Shader upscaleShader;
+};
+
+#endif
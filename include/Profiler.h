@@ -0,0 +1,53 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <string>
+
+// CPU scope profiler.
+// Build with -DCANDLE_PROFILE to compile it in; without it PROFILE_SCOPE expands to nothing
+// and the functions below are empty inlines, so the instrumentation costs nothing.
+//
+//   PROFILE_SCOPE("ParticleEmitter::update");   // times until the end of the enclosing block
+//
+// Every thread records into its own ring buffer (the last PROFILER_RING_SIZE scopes), with no
+// locks on the recording path. writeChromeTrace() dumps all rings as Chrome trace event JSON,
+// open it in chrome://tracing or ui.perfetto.dev. Scope names must be string literals.
+
+#ifdef CANDLE_PROFILE
+
+const bool PROFILER_ENABLED = true;
+const int PROFILER_RING_SIZE = 1 << 15; // per thread, power of two
+
+uint64_t profilerNow();  // nanoseconds since startup
+void profilerRecord(const char *name, uint64_t start, uint64_t end);
+// Shows up as the track name in the trace
+void profilerSetThreadName(const std::string &name);
+bool writeChromeTrace(const std::string &path);
+
+struct ProfileScope {
+    explicit ProfileScope(const char *name) : name(name), start(profilerNow()) {}
+    ~ProfileScope() { profilerRecord(name, start, profilerNow()); }
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+    const char *name;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#else
+
+const bool PROFILER_ENABLED = false;
+
+inline void profilerSetThreadName(const std::string &) {}
+inline bool writeChromeTrace(const std::string &) { return false; }
+
+#define PROFILE_SCOPE(name) ((void)0)
+
+#endif
+
+#endif
@@ -2,21 +2,33 @@
 #define ROOM_MODEL_H
 
 #include <GL/glew.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BufferArena.h"
+#include "LightmapBaker.h"
 
 class RoomModel {
 public:
-    RoomModel();
+    explicit RoomModel(BufferArena &arena);
     ~RoomModel();
     void draw();
 
+    // Bakes the diffuse light of static lights into lightmapTexture (or loads the cached bake).
+    // The runtime then only adds what these lights deviate from their baked intensity.
+    void bakeLightmap(ThreadPool &pool, const std::vector<PointLight> &lights,
+                      const std::vector<LightmapBox> &occluders);
+
     GLuint albedoTexture;
     GLuint normalTexture;
+    GLuint lightmapTexture; // 0 until bakeLightmap()
 
 private:
-    GLuint VAO, VBO;
-    int vertexCount;
+    BufferArena &arena;
+    ArenaMesh mesh;
+    float size;
+    glm::vec3 averageAlbedo;
 
-    GLuint loadTexture(const char* path);
+    GLuint loadTexture(const char* path, glm::vec3 *average = nullptr);
 };
 
 #endif
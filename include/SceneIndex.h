@@ -0,0 +1,78 @@
+#ifndef SCENE_INDEX_H
+#define SCENE_INDEX_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Six clip planes (a, b, c, d), a point is inside when a*x + b*y + c*z + d >= 0 for all of them
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Extracts the planes from a view-projection matrix (Gribb/Hartmann)
+Frustum frustumFromMatrix(const glm::mat4 &viewProjection);
+
+// Spatial index over the scene's bounding boxes for view culling.
+// A bounding volume hierarchy with four children per node, stored structure-of-arrays so the
+// four child boxes are tested against a frustum plane in one go with SSE. Subtrees that end up
+// fully inside the frustum are accepted without testing anything below them.
+//   add()/remove() mark the tree for a rebuild on the next cull()
+//   setBounds() refits: the object's slot and the boxes of its ancestors are updated in O(depth).
+//     Refitting never changes the tree's shape, so once moving objects have inflated the total
+//     node surface area by REBUILD_AREA_RATIO the tree is rebuilt from scratch.
+class SceneIndex {
+public:
+    SceneIndex();
+
+    int add(const Aabb &bounds); // returns the object id
+    void remove(int id);
+    void setBounds(int id, const Aabb &bounds);
+    const Aabb &getBounds(int id) const { return objects[id]; }
+
+    // Appends the ids of the objects whose box intersects the frustum
+    void cull(const Frustum &frustum, std::vector<int> &visible);
+
+    int getObjectCount() const { return objectCount; }
+    int getNodeCount() const { return (int)nodes.size(); }
+    int getRebuildCount() const { return rebuilds; }
+
+private:
+    struct Node {
+        alignas(16) float minX[4], minY[4], minZ[4];
+        alignas(16) float maxX[4], maxY[4], maxZ[4];
+        int child[4];   // node index, EMPTY_SLOT, or ~objectId for a leaf slot
+        int parent;     // -1 at the root
+        int parentSlot;
+    };
+
+    static const int EMPTY_SLOT = 0x7fffffff;
+    static constexpr float REBUILD_AREA_RATIO = 1.5f;
+
+    void rebuild();
+    int build(int *ids, int count, int parent, int parentSlot);
+    Aabb nodeBounds(const Node &node) const;
+    void setSlot(int nodeIndex, int slot, const Aabb &bounds);
+    void collect(int child, std::vector<int> &visible) const;
+    // Bit i of outside/inside is set when child box i is fully outside/inside the frustum
+    static void testNode(const Node &node, const Frustum &frustum, int &outside, int &inside);
+
+    std::vector<Aabb> objects;
+    std::vector<char> alive;
+    std::vector<int> freeIds;
+    std::vector<int> leafNode, leafSlot; // where each object sits in the tree
+    int objectCount;
+
+    std::vector<Node> nodes;
+    std::vector<int> stack;
+    bool dirty;
+    float buildArea;    // summed slot surface area right after the last rebuild
+    float area;         // same, kept up to date by refits
+    int rebuilds;
+};
+
+#endif
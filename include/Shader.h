@@ -16,6 +16,8 @@ public:
     void setFloat(const std::string &name, float value) const;
     void setInt(const std::string &name, int value) const;
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
+    void setVec2(const std::string &name, const glm::vec2 &vec) const;
+    void setIVec3(const std::string &name, int x, int y, int z) const;
     void setVec3(const std::string &name, const glm::vec3 &vec) const;
     void setVec4(const std::string &name, const glm::vec4 &vec) const;
 
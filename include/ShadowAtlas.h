@@ -0,0 +1,84 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <GL/glew.h>
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+#include "LightClusters.h"
+#include "Shader.h"
+
+// A resolution tier of the atlas: lights closer to the camera than maxDistance may use it.
+struct ShadowTier {
+    int tileSize;       // pixels per cube face
+    float maxDistance;
+    int slotCount;
+};
+
+// Omnidirectional shadows for point lights, cached in a single 2D depth atlas.
+// GL 3.3 has no cube map arrays, so each shadowed light owns a 3x2 block of tiles holding its
+// six cube faces. Depth is the light distance divided by the light radius, written by
+// shaders/shadow_depth.frag and compared in shaders/point_shadows.glsl.
+//
+// Every frame update() ranks the lights by camera distance and hands out slots, nearest
+// lights getting the larger tiers. A light keeps its slot (and its rendered map) for as long
+// as it stays in the same tier, and the map is only redrawn when the light itself or a caster
+// near it moved. render() redraws at most maxFaceUpdates faces per frame, nearest first; a
+// light whose map has not been drawn yet is simply unshadowed.
+class ShadowAtlas {
+public:
+    ShadowAtlas(int atlasSize = 3072,
+                const std::vector<ShadowTier> &tiers = {{512, 3.0f, 2}, {256, 6.0f, 6}, {128, 15.0f, 24}},
+                int maxFaceUpdates = 48);
+    ~ShadowAtlas();
+    ShadowAtlas(const ShadowAtlas &) = delete;
+    ShadowAtlas &operator=(const ShadowAtlas &) = delete;
+
+    // Assigns slots and marks stale maps. changedCasters holds bounding spheres (xyz center,
+    // w radius) of every caster that moved since last frame, at both its old and new position.
+    void update(const std::vector<PointLight> &lights, const glm::vec3 &viewPos,
+                const std::vector<glm::vec4> &changedCasters);
+
+    // Redraws the stale maps. drawCasters must draw every caster near the light with the given
+    // shader, setting uModel per object. Restores the framebuffer and viewport afterwards.
+    void render(const std::function<void(const Shader &, const PointLight &)> &drawCasters);
+
+    // Binds the atlas and the per-light slot table to firstUnit and firstUnit + 1.
+    void bind(const Shader &shader, int firstUnit) const;
+
+    // A light may wander this far from where its map was drawn before the map counts as stale
+    // (flicker jitter), default 1e-4
+    void setMoveTolerance(float distance) { moveTolerance = distance; }
+    // Drops every cached map, as if nothing had been rendered yet
+    void invalidate();
+
+    int getShadowedLightCount() const;
+    int getFacesRendered() const { return facesRendered; }
+
+private:
+    struct Slot {
+        int x, y;           // atlas pixel origin of the 3x2 block
+        int tier;
+        int light = -1;
+        bool valid = false; // the depth in the atlas matches the light below
+        glm::vec3 position;
+        float radius = 0.0f;
+    };
+
+    std::vector<ShadowTier> tiers;
+    std::vector<Slot> slots;
+    std::vector<int> lightSlot;     // per light, -1 when unshadowed
+    std::vector<int> rankedLights;  // nearest first
+    std::vector<PointLight> lights;
+    std::vector<float> slotTable;   // per light: (x, y, tile size, 0), tile size 0 when unshadowed
+    int atlasSize;
+    int maxFaceUpdates;
+    int facesRendered;
+    float moveTolerance;
+
+    GLuint FBO, depthTexture;
+    GLuint slotBuffer, slotTexture;
+    Shader depthShader;
+};
+
+#endif
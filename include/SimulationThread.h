@@ -0,0 +1,40 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+// Runs the simulation step at a fixed rate on its own thread.
+// The step publishes its results itself (see TripleBuffer), so the renderer never waits on the
+// simulation and the simulation never waits on the renderer. Before start() (or without it,
+// e.g. for a deterministic benchmark) steps can be run on the calling thread with stepNow().
+class SimulationThread {
+public:
+    SimulationThread(double rateHz, std::function<void(float dt)> step);
+    ~SimulationThread();
+    SimulationThread(const SimulationThread &) = delete;
+    SimulationThread &operator=(const SimulationThread &) = delete;
+
+    void start();
+    void stop();
+    bool isRunning() const { return thread.joinable(); }
+
+    // Only while the thread is not running
+    void stepNow(float dt) { step(dt); }
+
+    double getRate() const { return rateHz; }
+    // Steps dropped because the thread fell too far behind
+    long long getSkippedSteps() const { return skippedSteps.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    double rateHz;
+    std::function<void(float dt)> step;
+    std::atomic<bool> stopping;
+    std::atomic<long long> skippedSteps;
+    std::thread thread;
+};
+
+#endif
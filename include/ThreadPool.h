@@ -0,0 +1,49 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for data-parallel loops (light binning, baking, simulation).
+// parallelFor blocks until every chunk is done; the calling thread helps out.
+// Jobs from different threads are serialized, so threads that must not wait on each other need
+// pools of their own. Do not call parallelFor from inside a job.
+class ThreadPool {
+public:
+    // threadCount = 0 uses one worker per hardware thread minus the caller.
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Workers plus the calling thread.
+    int getThreadCount() const { return (int)workers.size() + 1; }
+
+    // Runs fn(begin, end) over [0, count) in chunks of grain items.
+    void parallelFor(int count, int grain, const std::function<void(int, int)> &fn);
+
+private:
+    void workerLoop(int index);
+    void runChunks();
+
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;   // one job at a time
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping;
+    unsigned long long generation;
+
+    const std::function<void(int, int)> *job;
+    int jobCount;
+    int jobGrain;
+    std::atomic<int> nextChunk;
+    int chunkCount;
+    int activeWorkers;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Lock-free single producer / single consumer triple buffer.
+// The writer fills writeBuffer() and publish()es it; the reader calls update() to switch to the
+// newest published value and reads readBuffer(). Neither side ever waits: the writer always has
+// a free slot, and unread values are simply replaced by newer ones. Slots are reused, so
+// containers inside T keep their capacity and steady state runs without allocations.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle(1), back(0), front(2) {}
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // Writer side
+    T &writeBuffer() { return slots[back]; }
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader side. Returns true when a newer value was published since the last call.
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T &readBuffer() const { return slots[front]; }
+
+private:
+    static const unsigned INDEX = 3;
+    static const unsigned FRESH = 4;   // set while the middle slot holds a value the reader has not taken
+
+    T slots[3];
+    std::atomic<unsigned> middle;
+    unsigned back;    // owned by the writer
+    unsigned front;   // owned by the reader
+};
+
+#endif
@@ -0,0 +1,34 @@
+#version 330 core
+// Dual filter downsample: the center plus four diagonal bilinear taps (13 texels for 5 fetches).
+// The first level also keeps only what is brighter than the threshold.
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D uSource;
+uniform vec2 uHalfTexel;    // half a texel of the source
+uniform bool uPrefilter;
+uniform float uThreshold;
+uniform float uKnee;
+
+vec3 prefilter(vec3 color) {
+    // Soft knee threshold, so bloom fades in instead of popping
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - uThreshold + uKnee, 0.0, 2.0 * uKnee);
+    soft = soft * soft / (4.0 * uKnee + 1e-5);
+    float contribution = max(soft, brightness - uThreshold) / max(brightness, 1e-5);
+    return color * contribution;
+}
+
+void main(){
+    vec3 sum = texture(uSource, TexCoord).rgb * 4.0;
+    sum += texture(uSource, TexCoord - uHalfTexel).rgb;
+    sum += texture(uSource, TexCoord + uHalfTexel).rgb;
+    sum += texture(uSource, TexCoord + vec2(uHalfTexel.x, -uHalfTexel.y)).rgb;
+    sum += texture(uSource, TexCoord - vec2(uHalfTexel.x, -uHalfTexel.y)).rgb;
+    vec3 color = sum / 8.0;
+    if (uPrefilter) {
+        color = prefilter(color);
+    }
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+// One step up the bloom chain, additively blended onto the larger level
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D uSource;
+uniform vec2 uHalfTexel;    // half a texel of the (smaller) source
+
+#include "bloom_upsample.glsl"
+
+void main(){
+    FragColor = vec4(bloomUpsample(uSource, TexCoord, uHalfTexel), 1.0);
+}
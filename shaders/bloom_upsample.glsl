@@ -0,0 +1,13 @@
+// Dual filter upsample (#include "bloom_upsample.glsl"): 8 bilinear taps on a diamond around
+// the pixel, weighted 1 on the axes and 2 on the diagonals.
+vec3 bloomUpsample(sampler2D source, vec2 uv, vec2 halfTexel) {
+    vec3 sum = texture(source, uv + vec2(-halfTexel.x * 2.0, 0.0)).rgb;
+    sum += texture(source, uv + vec2(-halfTexel.x, halfTexel.y)).rgb * 2.0;
+    sum += texture(source, uv + vec2(0.0, halfTexel.y * 2.0)).rgb;
+    sum += texture(source, uv + vec2(halfTexel.x, halfTexel.y)).rgb * 2.0;
+    sum += texture(source, uv + vec2(halfTexel.x * 2.0, 0.0)).rgb;
+    sum += texture(source, uv + vec2(halfTexel.x, -halfTexel.y)).rgb * 2.0;
+    sum += texture(source, uv + vec2(0.0, -halfTexel.y * 2.0)).rgb;
+    sum += texture(source, uv + vec2(-halfTexel.x, -halfTexel.y)).rgb * 2.0;
+    return sum / 12.0;
+}
@@ -5,30 +5,30 @@ in vec3 FragPos;
 in vec3 Normal;
 
 uniform vec3 viewPos;
-uniform vec3 lightPos;
-uniform vec3 lightColor;
 uniform vec3 candleColor;
 
+#include "clustered_lights.glsl"
+#include "material_lighting.glsl"
+#include "point_shadows.glsl"
+
 void main(){
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
-    float dist = length(lightPos - FragPos);
-
-    // Adjust the attenuation constants to get a larger radius of light
-    float attenuation = 1.0 / (1.0 + 0.09 * dist + 0.032 * dist * dist);
-
-    float ambientStrength = 0.5;
-    vec3 ambient = ambientStrength * lightColor;
-
-    float diff = max(dot(norm, lightDir),0.0);
-    vec3 diffuse = diff * lightColor;
-
-    float specularStrength = 0.3;
     vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);
-    float spec = pow(max(dot(viewDir, reflectDir),0.0),16);
-    vec3 specular = specularStrength * spec * lightColor;
 
-    vec3 result = (ambient + diffuse + specular) * candleColor * attenuation;
+    vec3 result = vec3(0.0);
+    uvec2 range = clusterLightRange(gl_FragCoord);
+    for (uint i = 0u; i < range.y; i++) {
+        vec3 lightPos, lightColor;
+        float lightRadius;
+        int lightIndex;
+        fetchClusterLight(range, i, lightPos, lightRadius, lightColor, lightIndex);
+
+        vec3 lightDir = normalize(lightPos - FragPos);
+        float dist = length(lightPos - FragPos);
+        float attenuation = lightAttenuation(dist, lightRadius);
+        attenuation *= pointShadow(lightIndex, FragPos, norm, lightPos, lightRadius);
+
+        result += candleLight(norm, viewDir, lightDir, candleColor, lightColor, attenuation);
+    }
     FragColor = vec4(result,1.0);
 }
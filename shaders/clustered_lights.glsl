@@ -0,0 +1,48 @@
+// Clustered light lookup shared by the lit shaders (#include "clustered_lights.glsl").
+// Buffers and uniforms are bound by LightClusters::bind().
+
+uniform samplerBuffer uLightData;     // 2 texels per light: (position, radius), (color, baked fraction)
+uniform usamplerBuffer uClusterGrid;  // per cluster: (first index, light count)
+uniform usamplerBuffer uLightIndices;
+uniform ivec3 uClusterDims;           // tiles x, tiles y, depth slices
+uniform float uClusterNear;
+uniform float uClusterFar;
+uniform vec2 uScreenSize;
+
+float linearDepth(float fragZ) {
+    float ndc = fragZ * 2.0 - 1.0;
+    return 2.0 * uClusterNear * uClusterFar / (uClusterFar + uClusterNear - ndc * (uClusterFar - uClusterNear));
+}
+
+// (first index, count) of the lights touching this fragment's cluster
+uvec2 clusterLightRange(vec4 fragCoord) {
+    ivec2 tile = ivec2(fragCoord.xy / uScreenSize * vec2(uClusterDims.xy));
+    tile = clamp(tile, ivec2(0), uClusterDims.xy - 1);
+    float depth = linearDepth(fragCoord.z);
+    int slice = int(floor(log(depth / uClusterNear) * float(uClusterDims.z) / log(uClusterFar / uClusterNear)));
+    slice = clamp(slice, 0, uClusterDims.z - 1);
+    int cluster = (slice * uClusterDims.y + tile.y) * uClusterDims.x + tile.x;
+    return texelFetch(uClusterGrid, cluster).xy;
+}
+
+// lightIndex is the light's position in the array given to LightClusters::update()
+void fetchClusterLight(uvec2 range, uint i, out vec3 position, out float radius, out vec3 color, out int lightIndex) {
+    lightIndex = int(texelFetch(uLightIndices, int(range.x + i)).r);
+    vec4 positionRadius = texelFetch(uLightData, lightIndex * 2);
+    position = positionRadius.xyz;
+    radius = positionRadius.w;
+    color = texelFetch(uLightData, lightIndex * 2 + 1).rgb;
+}
+
+// Share of the light's intensity that is already baked into the lightmap (0 for dynamic lights)
+float clusterLightBakedFraction(int lightIndex) {
+    return texelFetch(uLightData, lightIndex * 2 + 1).w;
+}
+
+// Same falloff as before, windowed to reach exactly zero at the light radius so clusters can cull it
+float lightAttenuation(float dist, float radius) {
+    float falloff = 1.0 / (1.0 + 0.09 * dist + 0.032 * (dist * dist));
+    float ratio = dist / radius;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return falloff * window * window;
+}
@@ -0,0 +1,68 @@
+#version 330 core
+// Full-screen light accumulation over the G-buffer. Every pixel only visits the lights of its
+// cluster, the same binning the forward path uses.
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;   // xyz world normal, w material id
+uniform sampler2D gBaked;    // rgb baked light, a = 1 when lightmapped
+uniform sampler2D gDepth;
+
+uniform mat4 uInvViewProjection;
+uniform vec3 viewPos;
+
+#include "clustered_lights.glsl"
+#include "material_lighting.glsl"
+#include "point_shadows.glsl"
+
+void main(){
+    float depth = texture(gDepth, TexCoord).r;
+    if (depth >= 1.0) {
+        discard; // background, keep the clear color
+    }
+    vec3 albedo = texture(gAlbedo, TexCoord).rgb;
+    vec4 normalMaterial = texture(gNormal, TexCoord);
+    vec3 N = normalize(normalMaterial.xyz);
+    bool isCandle = normalMaterial.w > 0.5;
+    vec4 baked = texture(gBaked, TexCoord);
+    bool lightmapped = baked.a > 0.5;
+
+    // World position back from the depth buffer
+    vec4 clip = vec4(TexCoord * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = uInvViewProjection * clip;
+    vec3 fragPos = world.xyz / world.w;
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 lighting = baked.rgb;
+    uvec2 range = clusterLightRange(vec4(gl_FragCoord.xy, depth, 1.0));
+    for (uint i = 0u; i < range.y; i++) {
+        vec3 lightPos, lightColor;
+        float lightRadius;
+        int lightIndex;
+        fetchClusterLight(range, i, lightPos, lightRadius, lightColor, lightIndex);
+
+        // Same flicker delta rule as room.frag
+        float bakedFraction = lightmapped ? clusterLightBakedFraction(lightIndex) : 0.0;
+        float flickerDelta = 1.0 - bakedFraction;
+        if (bakedFraction > 0.0 && abs(flickerDelta) < 0.001) {
+            continue;
+        }
+
+        vec3 toLight = lightPos - fragPos;
+        float dist = length(toLight);
+        vec3 lightDir = toLight / dist;
+        float attenuation = lightAttenuation(dist, lightRadius);
+        attenuation *= pointShadow(lightIndex, fragPos, N, lightPos, lightRadius);
+
+        if (isCandle) {
+            lighting += candleLight(N, viewDir, lightDir, albedo, lightColor, attenuation);
+        } else if (bakedFraction > 0.0) {
+            lighting += roomLightDiffuse(N, lightDir, albedo, lightColor * flickerDelta, attenuation);
+        } else {
+            lighting += roomLight(N, viewDir, lightDir, albedo, lightColor, attenuation);
+        }
+    }
+    FragColor = vec4(lighting, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+// Farthest depth of each uScale x uScale block of the full resolution depth buffer
+uniform sampler2D uDepth;
+uniform int uScale;
+
+void main(){
+    ivec2 size = textureSize(uDepth, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * uScale;
+    float depth = 0.0;
+    for (int y = 0; y < uScale; y++) {
+        for (int x = 0; x < uScale; x++) {
+            ivec2 p = min(base + ivec2(x, y), size - 1);
+            depth = max(depth, texelFetch(uDepth, p, 0).r);
+        }
+    }
+    gl_FragDepth = depth;
+}
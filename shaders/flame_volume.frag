@@ -0,0 +1,54 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 vLocal;
+
+uniform sampler3D uVolume;    // r = smoke density, g = temperature
+uniform sampler1D uBlackbody; // emission color over temperature, luminance 1 at the hottest
+uniform float uLutSize;
+uniform ivec3 uGridSize;
+uniform vec3 uBoxMin;
+uniform vec3 uBoxSize;
+uniform vec3 uCameraPos;
+uniform float uSampleRate;    // samples per cell, below 1 when over the frame's budget
+uniform int uMaxSteps;
+uniform float uOpacityCutoff;
+uniform float uEmptySkip;
+
+const float FLAME_GLOW = 15.0;    // emitted light per world unit at the hottest
+const float SMOKE_DENSITY = 4.0;  // absorption per world unit at full density
+const float EMPTY = 2.0 / 255.0;  // below this (smoke plus heat) a cell counts as empty
+
+void main(){
+    // March in volume coordinates from the front face to where the ray leaves the box
+    vec3 cameraLocal = (uCameraPos - uBoxMin) / uBoxSize;
+    vec3 dir = normalize(vLocal - cameraLocal);
+    vec3 exits = mix(1.0 - vLocal, vLocal, lessThan(dir, vec3(0.0))) / max(abs(dir), vec3(1e-6));
+    float rayLength = min(min(exits.x, exits.y), exits.z);
+
+    // uSampleRate samples per cell crossed, longer strides through empty cells
+    float stepLocal = 1.0 / (length(dir * vec3(uGridSize)) * uSampleRate);
+    float stepWorld = stepLocal * length(dir * uBoxSize);
+
+    vec3 color = vec3(0.0);
+    float transmittance = 1.0;
+    float t = 0.5 * stepLocal;
+    for (int i = 0; i < uMaxSteps && t < rayLength; i++) {
+        vec2 cell = texture(uVolume, vLocal + dir * t).rg;
+        if (cell.r + cell.g < EMPTY) {
+            t += stepLocal * uEmptySkip;
+            continue;
+        }
+        vec3 glow = texture(uBlackbody, (cell.g * (uLutSize - 1.0) + 0.5) / uLutSize).rgb * FLAME_GLOW;
+        color += transmittance * glow * stepWorld;
+        transmittance *= exp(-cell.r * SMOKE_DENSITY * stepWorld);
+        // Nothing behind shows through any more
+        if (transmittance < 1.0 - uOpacityCutoff) {
+            break;
+        }
+        t += stepLocal;
+    }
+
+    // Premultiplied: the glow adds, the smoke hides the scene behind it
+    FragColor = vec4(color, 1.0 - transmittance);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+layout(location=0) in vec3 aPos; // unit cube
+
+uniform mat4 uProjection;
+uniform mat4 uView;
+uniform vec3 uBoxMin;
+uniform vec3 uBoxSize;
+
+out vec3 vLocal; // position in the volume, [0, 1] per axis
+
+void main(){
+    vLocal = aPos;
+    gl_Position = uProjection * uView * vec4(uBoxMin + aPos * uBoxSize, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+// Candle material into the G-buffer (deferred path). Lighting happens in deferred_lighting.frag.
+layout(location=0) out vec4 gAlbedo;
+layout(location=1) out vec4 gNormal;
+layout(location=2) out vec4 gBaked;
+
+in vec3 FragPos;
+in vec3 Normal;
+
+uniform vec3 candleColor;
+
+#include "material_lighting.glsl"
+
+void main(){
+    gAlbedo = vec4(candleColor, 1.0);
+    gNormal = vec4(normalize(Normal), MATERIAL_CANDLE);
+    gBaked = vec4(0.0);
+}
@@ -0,0 +1,28 @@
+#version 330 core
+// Room material into the G-buffer (deferred path). Lighting happens in deferred_lighting.frag.
+layout(location=0) out vec4 gAlbedo;
+layout(location=1) out vec4 gNormal;
+layout(location=2) out vec4 gBaked;
+
+in vec3 FragPos;
+in vec2 TexCoord;
+in vec2 LightmapCoord;
+in mat3 TBN;
+
+uniform sampler2D uAlbedoMap;
+uniform sampler2D uNormalMap;
+uniform sampler2D uLightmap;
+uniform bool uLightmapEnabled;
+
+#include "material_lighting.glsl"
+
+void main(){
+    vec3 albedo = texture(uAlbedoMap, TexCoord).rgb;
+    vec3 tangentNormal = texture(uNormalMap, TexCoord).rgb * 2.0 - 1.0;
+    vec3 N = normalize(TBN * tangentNormal);
+
+    gAlbedo = vec4(albedo, 1.0);
+    gNormal = vec4(N, MATERIAL_ROOM);
+    // Baked light, alpha tells the lighting pass to treat baked lights as flicker deltas
+    gBaked = uLightmapEnabled ? vec4(albedo * texture(uLightmap, LightmapCoord).rgb, 1.0) : vec4(0.0);
+}
@@ -0,0 +1,41 @@
+// Per-light response of the two scene materials (#include "material_lighting.glsl").
+// The forward shaders and the deferred lighting pass both call these, so the two paths match.
+
+const float MATERIAL_ROOM = 0.0;
+const float MATERIAL_CANDLE = 1.0;
+
+// Textured walls: Blinn-Phong with a white highlight, no ambient
+vec3 roomLight(vec3 N, vec3 viewDir, vec3 lightDir, vec3 albedo, vec3 lightColor, float attenuation) {
+    float specularStrength = 0.5;
+
+    float diff = max(dot(N, lightDir), 0.0);
+    vec3 diffuse = diff * albedo;
+
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(N, halfwayDir), 0.0), 16);
+    vec3 specular = specularStrength * spec * vec3(1.0);
+
+    return (diffuse + specular) * lightColor * attenuation;
+}
+
+// Diffuse part of roomLight() alone. Lightmapped surfaces use it for the flicker delta of baked lights.
+vec3 roomLightDiffuse(vec3 N, vec3 lightDir, vec3 albedo, vec3 lightColor, float attenuation) {
+    return max(dot(N, lightDir), 0.0) * albedo * lightColor * attenuation;
+}
+
+// Wax: Phong with a strong per-light ambient, everything tinted by the candle color
+vec3 candleLight(vec3 N, vec3 viewDir, vec3 lightDir, vec3 candleColor, vec3 lightColor, float attenuation) {
+    float ambientStrength = 0.5;
+    float specularStrength = 0.3;
+
+    vec3 ambient = ambientStrength * lightColor;
+
+    float diff = max(dot(N, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor;
+
+    vec3 reflectDir = reflect(-lightDir, N);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 16);
+    vec3 specular = specularStrength * spec * lightColor;
+
+    return (ambient + diffuse + specular) * candleColor * attenuation;
+}
@@ -3,9 +3,10 @@ layout(location=0) in vec3 aPos;
 
 uniform mat4 uProjection;
 uniform mat4 uView;
+uniform float uPointScale; // 1 at full resolution, smaller when drawn into a reduced target
 
 void main(){
     gl_Position = uProjection * uView * vec4(aPos,1.0);
     // Adjust point size if needed, or pass as uniform
-    gl_PointSize = 15.0; // smaller for core flame emitter, larger for haze emitter
+    gl_PointSize = 15.0 * uPointScale; // smaller for core flame emitter, larger for haze emitter
 }
@@ -0,0 +1,43 @@
+#version 330 core
+// Bilateral upsample of the low resolution particles: the four nearest low-res texels are
+// weighted bilinearly and by how close their depth is to this pixel's depth, so particles
+// behind a candle edge do not smear over it.
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D uParticles;
+uniform sampler2D uLowDepth;
+uniform sampler2D uSceneDepth;
+uniform int uScale;
+uniform float uNear;
+uniform float uFar;
+
+float linearize(float depth) {
+    float ndc = depth * 2.0 - 1.0;
+    return 2.0 * uNear * uFar / (uFar + uNear - ndc * (uFar - uNear));
+}
+
+void main(){
+    float depth = linearize(texelFetch(uSceneDepth, ivec2(gl_FragCoord.xy), 0).r);
+
+    ivec2 lowSize = textureSize(uParticles, 0);
+    vec2 lowPos = gl_FragCoord.xy / float(uScale) - 0.5;
+    ivec2 base = ivec2(floor(lowPos));
+    vec2 f = lowPos - vec2(base);
+
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 p = clamp(base + offset, ivec2(0), lowSize - 1);
+        float bilinear = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        float lowDepth = linearize(texelFetch(uLowDepth, p, 0).r);
+        float similarity = 1.0 / (0.01 + abs(lowDepth - depth) / depth);
+        float weight = bilinear * similarity + 1e-5;
+        sum += texelFetch(uParticles, p, 0) * weight;
+        weightSum += weight;
+    }
+    // Alpha is only used when compositing alpha blended particles, the scene's stays as it is
+    FragColor = sum / weightSum;
+}
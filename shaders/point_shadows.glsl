@@ -0,0 +1,46 @@
+// Point light shadow lookup (#include "point_shadows.glsl"), bound by ShadowAtlas::bind().
+// Each shadowed light has six cube faces laid out as a 3x2 block of tiles in one depth atlas.
+
+uniform sampler2DShadow uShadowAtlas;
+uniform samplerBuffer uShadowSlots;   // per light: (x, y, tile size) in atlas pixels, tile size 0 = no shadow
+uniform float uShadowAtlasSize;
+
+// Face order and orientation match ShadowAtlas.cpp
+const vec3 SHADOW_FACE_FORWARD[6] = vec3[6](
+    vec3( 1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3( 0.0,-1.0, 0.0), vec3( 0.0, 0.0, 1.0), vec3(0.0, 0.0,-1.0));
+const vec3 SHADOW_FACE_UP[6] = vec3[6](
+    vec3(0.0,-1.0, 0.0), vec3(0.0,-1.0, 0.0), vec3(0.0, 0.0, 1.0),
+    vec3(0.0, 0.0,-1.0), vec3(0.0,-1.0, 0.0), vec3(0.0,-1.0, 0.0));
+
+// 1.0 = fully lit. N pushes the lookup off the surface to avoid acne.
+float pointShadow(int lightIndex, vec3 fragPos, vec3 N, vec3 lightPos, float lightRadius) {
+    vec4 slot = texelFetch(uShadowSlots, lightIndex);
+    if (slot.z <= 0.0) {
+        return 1.0;
+    }
+    vec3 d = fragPos + N * 0.02 - lightPos;
+    vec3 a = abs(d);
+    int face;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = d.x > 0.0 ? 0 : 1;
+    } else if (a.y >= a.z) {
+        face = d.y > 0.0 ? 2 : 3;
+    } else {
+        face = d.z > 0.0 ? 4 : 5;
+    }
+
+    // Same basis glm::lookAt builds for the face
+    vec3 f = SHADOW_FACE_FORWARD[face];
+    vec3 s = normalize(cross(f, SHADOW_FACE_UP[face]));
+    vec3 u = cross(s, f);
+    vec2 uv = vec2(dot(d, s), dot(d, u)) / dot(d, f) * 0.5 + 0.5;
+
+    // Stay half a texel inside the tile so filtering never reads the neighbouring face
+    float halfTexel = 0.5 / slot.z;
+    uv = clamp(uv, vec2(halfTexel), vec2(1.0 - halfTexel));
+    vec2 texel = slot.xy + vec2(float(face % 3), float(face / 3)) * slot.z + uv * slot.z;
+
+    float reference = length(d) / lightRadius - 0.002;
+    return texture(uShadowAtlas, vec3(texel / uShadowAtlasSize, reference));
+}
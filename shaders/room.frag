@@ -1,41 +1,64 @@
 #version 330 core
 out vec4 FragColor;
 
+in vec3 FragPos;
 in vec2 TexCoord;
-in vec3 TangentLightPos;
-in vec3 TangentViewPos;
-in vec3 TangentFragPos;
+in vec2 LightmapCoord;
+in mat3 TBN;
 
 uniform sampler2D uAlbedoMap;
 uniform sampler2D uNormalMap;
+uniform sampler2D uLightmap;
+uniform bool uLightmapEnabled;
 
-uniform vec3 lightColor;
+uniform vec3 viewPos;
+
+#include "clustered_lights.glsl"
+#include "material_lighting.glsl"
+#include "point_shadows.glsl"
 
 void main(){
     vec3 albedo = texture(uAlbedoMap, TexCoord).rgb;
     vec3 normalColor = texture(uNormalMap, TexCoord).rgb;
     vec3 tangentNormal = normalColor * 2.0 - 1.0;
 
-    vec3 N = normalize(tangentNormal);
-    vec3 lightDir = normalize(TangentLightPos - TangentFragPos);
-    vec3 viewDir = normalize(TangentViewPos - TangentFragPos);
-
-    float dist = length(TangentLightPos - TangentFragPos);
-    // Adjust these to control how far the light reaches:
-    float attenuation = 1.0 / (1.0 + 0.09 * dist + 0.032 * (dist * dist));
+    vec3 N = normalize(TBN * tangentNormal);
+    vec3 viewDir = normalize(viewPos - FragPos);
 
     // Minimal or no ambient:
     float ambientStrength = 0.0;
-    vec3 ambient = ambientStrength * albedo;
+    vec3 lighting = ambientStrength * albedo;
+    if (uLightmapEnabled) {
+        // Static candles, baked with shadows and one bounce (RoomModel::bakeLightmap)
+        lighting += albedo * texture(uLightmap, LightmapCoord).rgb;
+    }
+
+    // Only the lights whose range touches this fragment's cluster
+    uvec2 range = clusterLightRange(gl_FragCoord);
+    for (uint i = 0u; i < range.y; i++) {
+        vec3 lightPos, lightColor;
+        float lightRadius;
+        int lightIndex;
+        fetchClusterLight(range, i, lightPos, lightRadius, lightColor, lightIndex);
+
+        // Baked lights only add how far they flicker from the baked intensity, diffuse only
+        float bakedFraction = uLightmapEnabled ? clusterLightBakedFraction(lightIndex) : 0.0;
+        float flickerDelta = 1.0 - bakedFraction;
+        if (bakedFraction > 0.0 && abs(flickerDelta) < 0.001) {
+            continue;
+        }
 
-    float diff = max(dot(N, lightDir), 0.0);
-    vec3 diffuse = diff * albedo;
+        vec3 toLight = lightPos - FragPos;
+        float dist = length(toLight);
+        float attenuation = lightAttenuation(dist, lightRadius);
+        attenuation *= pointShadow(lightIndex, FragPos, N, lightPos, lightRadius);
 
-    float specularStrength = 0.5;
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(N, halfwayDir), 0.0), 16);
-    vec3 specular = specularStrength * spec * vec3(1.0);
+        if (bakedFraction > 0.0) {
+            lighting += roomLightDiffuse(N, toLight / dist, albedo, lightColor * flickerDelta, attenuation);
+        } else {
+            lighting += roomLight(N, viewDir, toLight / dist, albedo, lightColor, attenuation);
+        }
+    }
 
-    vec3 lighting = (ambient + diffuse + specular) * lightColor * attenuation;
     FragColor = vec4(lighting,1.0);
 }
@@ -0,0 +1,11 @@
+#version 330 core
+// Stores the distance to the light instead of projective depth, so all six faces of a light
+// compare against the same value in point_shadows.glsl.
+in vec3 WorldPos;
+
+uniform vec3 uLightPos;
+uniform float uLightRadius;
+
+void main(){
+    gl_FragDepth = clamp(length(WorldPos - uLightPos) / uLightRadius, 0.0, 1.0);
+}
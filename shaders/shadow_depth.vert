@@ -0,0 +1,14 @@
+#version 330 core
+// Caster geometry for one cube face of a point light shadow (ShadowAtlas::render).
+layout(location=0) in vec3 aPos;
+
+uniform mat4 uViewProjection;
+uniform mat4 uModel;
+
+out vec3 WorldPos;
+
+void main(){
+    vec4 worldPos = uModel * vec4(aPos,1.0);
+    WorldPos = worldPos.xyz;
+    gl_Position = uViewProjection * worldPos;
+}
@@ -0,0 +1,28 @@
+#version 330 core
+// HDR resolve: scene + bloom, exposure, filmic curve.
+// Lighting and textures stay in display space as before, so no extra gamma step here.
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D uScene;
+uniform sampler2D uBloom;
+uniform vec2 uBloomHalfTexel;
+uniform float uBloomStrength;
+uniform float uExposure;
+
+#include "bloom_upsample.glsl"
+
+// Narkowicz's fit of the ACES reference rendering transform
+vec3 acesFilmic(vec3 x) {
+    const float a = 2.51, b = 0.03, c = 2.43, d = 0.59, e = 0.14;
+    return clamp((x * (a * x + b)) / (x * (c * x + d) + e), 0.0, 1.0);
+}
+
+void main(){
+    vec3 color = texture(uScene, TexCoord).rgb;
+    if (uBloomStrength > 0.0) {
+        color += bloomUpsample(uBloom, TexCoord, uBloomHalfTexel) * uBloomStrength;
+    }
+    FragColor = vec4(acesFilmic(color * uExposure), 1.0);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+// Upscale of the tonemapped image from the render resolution to the output, with contrast
+// adaptive sharpening (after AMD's CAS): the bilinear result gets a negative lobe from its
+// four neighbours, weaker where the local contrast is already high so edges do not ring.
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D uSource;
+uniform vec2 uSourceTexel;   // 1 / source size
+uniform float uSharpness;    // 0 = mild, 1 = strongest
+
+void main(){
+    vec3 center = texture(uSource, TexCoord).rgb;
+    vec3 north = texture(uSource, TexCoord + vec2(0.0, uSourceTexel.y)).rgb;
+    vec3 south = texture(uSource, TexCoord - vec2(0.0, uSourceTexel.y)).rgb;
+    vec3 east = texture(uSource, TexCoord + vec2(uSourceTexel.x, 0.0)).rgb;
+    vec3 west = texture(uSource, TexCoord - vec2(uSourceTexel.x, 0.0)).rgb;
+
+    vec3 minColor = min(center, min(min(north, south), min(east, west)));
+    vec3 maxColor = max(center, max(max(north, south), max(east, west)));
+    vec3 amount = sqrt(clamp(min(minColor, 1.0 - maxColor) / max(maxColor, 1e-4), 0.0, 1.0));
+    vec3 weight = -amount / mix(8.0, 5.0, uSharpness);
+
+    vec3 color = (center + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);
+    FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
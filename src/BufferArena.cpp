@@ -0,0 +1,274 @@
+#include "BufferArena.h"
+#include <algorithm>
+
+RangeAllocator::RangeAllocator(size_t capacity) : capacity(capacity), used(0) {
+    if (capacity > 0) {
+        freeRanges[0] = capacity;
+    }
+}
+
+bool RangeAllocator::allocate(size_t size, size_t alignment, size_t &offset) {
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        size_t start = (it->first + alignment - 1) / alignment * alignment;
+        size_t end = it->first + it->second;
+        if (start + size > end) {
+            continue;
+        }
+        // Split the free range around the allocation (the alignment gap stays free)
+        size_t rangeStart = it->first;
+        freeRanges.erase(it);
+        if (start > rangeStart) {
+            freeRanges[rangeStart] = start - rangeStart;
+        }
+        if (start + size < end) {
+            freeRanges[start + size] = end - (start + size);
+        }
+        offset = start;
+        used += size;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(size_t offset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    used -= size;
+    auto it = freeRanges.emplace(offset, size).first;
+
+    // Merge with the following range
+    auto next = std::next(it);
+    if (next != freeRanges.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        freeRanges.erase(next);
+    }
+    // Merge with the preceding range
+    if (it != freeRanges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            freeRanges.erase(it);
+        }
+    }
+}
+
+void RangeAllocator::grow(size_t newCapacity) {
+    if (newCapacity <= capacity) {
+        return;
+    }
+    free(capacity, newCapacity - capacity);
+    used += newCapacity - capacity; // free() above subtracted it, growing does not change usage
+    capacity = newCapacity;
+}
+
+BufferArena::BufferArena(size_t vertexBytesPerFormat, size_t indexBytes)
+: initialVertexBytes(vertexBytesPerFormat), EBO(0), indexAllocator(indexBytes), boundFormat(-1)
+{
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+}
+
+BufferArena::~BufferArena() {
+    for (Format &format : formats) {
+        glDeleteVertexArrays(1, &format.VAO);
+        glDeleteBuffers(1, &format.VBO);
+    }
+    glDeleteBuffers(1, &EBO);
+}
+
+static bool SameLayout(const VertexLayout &a, const VertexLayout &b) {
+    if (a.stride != b.stride || a.attributes.size() != b.attributes.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.attributes.size(); i++) {
+        const VertexAttribute &x = a.attributes[i];
+        const VertexAttribute &y = b.attributes[i];
+        if (x.location != y.location || x.components != y.components || x.offset != y.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int BufferArena::findOrCreateFormat(const VertexLayout &layout, GLenum usage) {
+    for (size_t i = 0; i < formats.size(); i++) {
+        if (formats[i].usage == usage && SameLayout(formats[i].layout, layout)) {
+            return (int)i;
+        }
+    }
+
+    Format format;
+    format.layout = layout;
+    format.usage = usage;
+    format.allocator = RangeAllocator(std::max<size_t>(initialVertexBytes / layout.stride, 1));
+
+    glGenBuffers(1, &format.VBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, format.VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, format.allocator.getCapacity() * layout.stride, nullptr, usage);
+
+    glGenVertexArrays(1, &format.VAO);
+    setupAttributes(format);
+
+    formats.push_back(format);
+    return (int)formats.size() - 1;
+}
+
+void BufferArena::setupAttributes(const Format &format) {
+    glBindVertexArray(format.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, format.VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    for (const VertexAttribute &attribute : format.layout.attributes) {
+        glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE,
+                              format.layout.stride, (void*)(size_t)attribute.offset);
+        glEnableVertexAttribArray(attribute.location);
+    }
+    glBindVertexArray(0);
+    boundFormat = -1;
+}
+
+void BufferArena::growVertexBuffer(Format &format, size_t minVertices) {
+    size_t oldCapacity = format.allocator.getCapacity();
+    size_t newCapacity = oldCapacity * 2;
+    while (newCapacity < oldCapacity + minVertices) {
+        newCapacity *= 2;
+    }
+
+    // Copy the old contents over on the GPU, offsets stay valid
+    GLuint newVBO;
+    glGenBuffers(1, &newVBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * format.layout.stride, nullptr, format.usage);
+    glBindBuffer(GL_COPY_READ_BUFFER, format.VBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldCapacity * format.layout.stride);
+    glDeleteBuffers(1, &format.VBO);
+
+    format.VBO = newVBO;
+    format.allocator.grow(newCapacity);
+    setupAttributes(format);
+}
+
+void BufferArena::growIndexBuffer(size_t minBytes) {
+    size_t oldCapacity = indexAllocator.getCapacity();
+    size_t newCapacity = oldCapacity * 2;
+    while (newCapacity < oldCapacity + minBytes) {
+        newCapacity *= 2;
+    }
+
+    GLuint newEBO;
+    glGenBuffers(1, &newEBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newEBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldCapacity);
+    glDeleteBuffers(1, &EBO);
+
+    EBO = newEBO;
+    indexAllocator.grow(newCapacity);
+    // The index buffer binding is VAO state, every format has to pick up the new one
+    for (Format &format : formats) {
+        setupAttributes(format);
+    }
+}
+
+ArenaMesh BufferArena::allocateMesh(const VertexLayout &layout, const void *vertices, size_t vertexCount,
+                                    const void *indices, size_t indexCount, unsigned int indexSize) {
+    ArenaMesh mesh;
+    mesh.format = findOrCreateFormat(layout, GL_STATIC_DRAW);
+    Format &format = formats[mesh.format];
+
+    size_t vertexOffset;
+    if (!format.allocator.allocate(vertexCount, 1, vertexOffset)) {
+        growVertexBuffer(format, vertexCount);
+        format.allocator.allocate(vertexCount, 1, vertexOffset);
+    }
+    mesh.baseVertex = (GLint)vertexOffset;
+    mesh.vertexCount = vertexCount;
+
+    // Keep every index range 4-byte aligned so 16 and 32 bit meshes can share the buffer
+    mesh.indexBytes = indexCount * indexSize;
+    mesh.indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if (!indexAllocator.allocate(mesh.indexBytes, 4, mesh.indexOffset)) {
+        growIndexBuffer(mesh.indexBytes);
+        indexAllocator.allocate(mesh.indexBytes, 4, mesh.indexOffset);
+    }
+
+    // Upload through the copy target so no VAO's element binding gets disturbed
+    glBindBuffer(GL_COPY_WRITE_BUFFER, format.VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * layout.stride, vertexCount * layout.stride, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.indexOffset, mesh.indexBytes, indices);
+
+    return mesh;
+}
+
+void BufferArena::freeMesh(ArenaMesh &mesh) {
+    if (mesh.format < 0) {
+        return;
+    }
+    formats[mesh.format].allocator.free((size_t)mesh.baseVertex, mesh.vertexCount);
+    indexAllocator.free(mesh.indexOffset, mesh.indexBytes);
+    mesh = ArenaMesh();
+}
+
+ArenaStream BufferArena::allocateStream(const VertexLayout &layout, size_t vertexCapacity) {
+    ArenaStream stream;
+    stream.format = findOrCreateFormat(layout, GL_DYNAMIC_DRAW);
+    Format &format = formats[stream.format];
+
+    size_t offset;
+    if (!format.allocator.allocate(vertexCapacity, 1, offset)) {
+        growVertexBuffer(format, vertexCapacity);
+        format.allocator.allocate(vertexCapacity, 1, offset);
+    }
+    stream.firstVertex = (GLint)offset;
+    stream.vertexCapacity = vertexCapacity;
+    return stream;
+}
+
+void BufferArena::updateStream(const ArenaStream &stream, const void *vertices, size_t vertexCount) {
+    const Format &format = formats[stream.format];
+    vertexCount = std::min(vertexCount, stream.vertexCapacity);
+    if (vertexCount == 0) {
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, format.VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)stream.firstVertex * format.layout.stride,
+                    vertexCount * format.layout.stride, vertices);
+}
+
+void BufferArena::freeStream(ArenaStream &stream) {
+    if (stream.format < 0) {
+        return;
+    }
+    formats[stream.format].allocator.free((size_t)stream.firstVertex, stream.vertexCapacity);
+    stream = ArenaStream();
+}
+
+void BufferArena::bindFormat(int format) {
+    if (format != boundFormat) {
+        glBindVertexArray(formats[format].VAO);
+        boundFormat = format;
+    }
+}
+
+void BufferArena::drawElements(const ArenaMesh &mesh, GLenum mode, GLsizei indexCount, size_t firstIndex) {
+    bindFormat(mesh.format);
+    size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    glDrawElementsBaseVertex(mode, indexCount, mesh.indexType,
+                             (void*)(mesh.indexOffset + firstIndex * indexSize), mesh.baseVertex);
+}
+
+void BufferArena::drawArrays(const ArenaStream &stream, GLenum mode, GLsizei vertexCount) {
+    bindFormat(stream.format);
+    glDrawArrays(mode, stream.firstVertex, std::min(vertexCount, (GLsizei)stream.vertexCapacity));
+}
+
+size_t BufferArena::getVertexBytesUsed() const {
+    size_t bytes = 0;
+    for (const Format &format : formats) {
+        bytes += format.allocator.getUsed() * format.layout.stride;
+    }
+    return bytes;
+}
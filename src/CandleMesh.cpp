@@ -0,0 +1,214 @@
+#include "CandleMesh.h"
+#include <array>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// This generator creates a candle with:
+// - Cylindrical sides with a configurable number of segments
+// - A slightly indented top surface
+// - A simple wick, tessellated separately since it is much thinner than the body
+//
+// Every ring of the candle uses the same angles, so cos/sin come from one table per
+// segment count. Tables for the standard LOD counts are built at compile time.
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Taylor series, good to ~1e-13 on [-pi, pi]. Only used to fill the constexpr tables.
+constexpr double taylorSin(double x) {
+    double term = x, sum = x;
+    for (int n = 1; n < 13; n++) {
+        term *= -x * x / ((2*n) * (2*n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double taylorCos(double x) {
+    double term = 1.0, sum = 1.0;
+    for (int n = 1; n < 13; n++) {
+        term *= -x * x / ((2*n - 1) * (2*n));
+        sum += term;
+    }
+    return sum;
+}
+
+template<int N>
+struct FixedRingTable {
+    std::array<float, N + 1> cosTable{};
+    std::array<float, N + 1> sinTable{};
+
+    constexpr FixedRingTable() {
+        for (int i = 0; i <= N; i++) {
+            // Map to [-pi, pi] so the series converges quickly
+            double theta = (double)i / N * 2.0 * kPi;
+            if (theta > kPi) {
+                theta -= 2.0 * kPi;
+            }
+            cosTable[i] = (float)taylorCos(theta);
+            sinTable[i] = (float)taylorSin(theta);
+        }
+    }
+
+    RingTable view() const { return RingTable{N, cosTable.data(), sinTable.data()}; }
+};
+
+constexpr FixedRingTable<64> kRing64;
+constexpr FixedRingTable<24> kRing24;
+constexpr FixedRingTable<8> kRing8;
+constexpr FixedRingTable<3> kRing3;
+
+// Other segment counts are computed once and kept for the lifetime of the program
+struct RuntimeRingTable {
+    std::vector<float> cosTable;
+    std::vector<float> sinTable;
+};
+
+} // namespace
+
+RingTable getRingTable(int segments) {
+    switch (segments) {
+        case 64: return kRing64.view();
+        case 24: return kRing24.view();
+        case 8: return kRing8.view();
+        case 3: return kRing3.view();
+        default: break;
+    }
+
+    static std::mutex mutex;
+    static std::map<int, std::unique_ptr<RuntimeRingTable>> tables;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::unique_ptr<RuntimeRingTable> &table = tables[segments];
+    if (!table) {
+        table.reset(new RuntimeRingTable());
+        table->cosTable.resize(segments + 1);
+        table->sinTable.resize(segments + 1);
+        for (int i = 0; i <= segments; i++) {
+            double theta = (double)i / segments * 2.0 * kPi;
+            table->cosTable[i] = (float)std::cos(theta);
+            table->sinTable[i] = (float)std::sin(theta);
+        }
+    }
+    return RingTable{segments, table->cosTable.data(), table->sinTable.data()};
+}
+
+void getCandleMeshSize(int segments, int wickSegments, int &vertexCount, int &indexCount) {
+    // side (2 rings) + outer top ring + inner top ring + center + wick (2 rings)
+    vertexCount = 4*(segments + 1) + 1 + 2*(wickSegments + 1);
+    // side quads + top quads + center fan + wick quads
+    indexCount = 6*segments + 6*segments + 3*segments + 6*wickSegments;
+}
+
+void generateCandleMesh(const CandleParams &params, int segments, int wickSegments,
+                        float *vertices, unsigned int *indices, unsigned int baseVertex) {
+    const RingTable ring = getRingTable(segments);
+    const RingTable wickRing = getRingTable(wickSegments);
+
+    float radius = params.radius;
+    float topY = params.height/2.0f;
+    float bottomY = -params.height/2.0f;
+
+    // We'll create the candle in parts:
+    // 1. The cylindrical side.
+    // 2. The top indentation:
+    //    - Outer ring at top (same radius),
+    //    - Inner ring slightly smaller radius and slightly lower y to create a dip.
+    // 3. A small wick at the center.
+
+    // Vertices format: position (x,y,z), normal (nx,ny,nz)
+    float *v = vertices;
+    unsigned int *idx = indices;
+    auto addVertex = [&v](float x, float y, float z, float nx, float ny, float nz) {
+        v[0] = x; v[1] = y; v[2] = z;
+        v[3] = nx; v[4] = ny; v[5] = nz;
+        v += 6;
+    };
+    auto addTriangle = [&idx, baseVertex](unsigned int a, unsigned int b, unsigned int c) {
+        idx[0] = baseVertex + a; idx[1] = baseVertex + b; idx[2] = baseVertex + c;
+        idx += 3;
+    };
+
+    // Side: interleaved top/bottom vertices, normals point straight out
+    for (int i = 0; i <= segments; i++) {
+        float c = ring.cosTable[i];
+        float s = ring.sinTable[i];
+        addVertex(radius*c, topY, radius*s, c, 0.0f, s);
+        addVertex(radius*c, bottomY, radius*s, c, 0.0f, s);
+    }
+    for (int i = 0; i < segments; i++) {
+        unsigned int top1 = i*2;
+        unsigned int bot1 = i*2 + 1;
+        unsigned int top2 = (i+1)*2;
+        unsigned int bot2 = (i+1)*2 + 1;
+        addTriangle(top1, bot1, top2);
+        addTriangle(top2, bot1, bot2);
+    }
+
+    // Top indentation: outer ring at the rim, inner ring smaller and slightly lower.
+    // Both use an up normal (simplified).
+    float innerRadius = radius * params.innerRadiusRatio;
+    float innerY = topY - params.dipDepth; // a small dip
+
+    unsigned int outerStart = 2*(segments + 1);
+    for (int i = 0; i <= segments; i++) {
+        addVertex(radius*ring.cosTable[i], topY, radius*ring.sinTable[i], 0.0f,1.0f,0.0f);
+    }
+    unsigned int innerStart = outerStart + segments + 1;
+    for (int i = 0; i <= segments; i++) {
+        addVertex(innerRadius*ring.cosTable[i], innerY, innerRadius*ring.sinTable[i], 0.0f,1.0f,0.0f);
+    }
+    for (int i = 0; i < segments; i++) {
+        unsigned int o1 = outerStart + i;
+        unsigned int o2 = outerStart + (i+1);
+        unsigned int in1 = innerStart + i;
+        unsigned int in2 = innerStart + (i+1);
+        addTriangle(o1, in1, o2);
+        addTriangle(o2, in1, in2);
+    }
+
+    // Cap the inner ring with a single center vertex, slightly lower to simulate the melted area
+    float centerY = innerY - params.centerDip;
+    unsigned int centerIndex = innerStart + segments + 1;
+    addVertex(0.0f, centerY, 0.0f, 0.0f,1.0f,0.0f);
+    for (int i = 0; i < segments; i++) {
+        addTriangle(centerIndex, innerStart + i, innerStart + (i+1));
+    }
+
+    // Wick: a very thin vertical cylinder at the center.
+    // It is only a few pixels wide even up close, so it gets its own (much lower) segment count.
+    float wickRadius = params.wickRadius;
+    float wickBaseY = centerY;
+    float wickTopY = wickBaseY + params.wickHeight;
+
+    unsigned int wickBaseStart = centerIndex + 1;
+    for (int i = 0; i <= wickSegments; i++) {
+        float c = wickRing.cosTable[i];
+        float s = wickRing.sinTable[i];
+        addVertex(wickRadius*c, wickBaseY, wickRadius*s, c, 0.0f, s);
+        addVertex(wickRadius*c, wickTopY, wickRadius*s, c, 0.0f, s);
+    }
+    for (int i = 0; i < wickSegments; i++) {
+        unsigned int wb1 = wickBaseStart + i*2;
+        unsigned int wb2 = wb1+1;
+        unsigned int wb3 = wickBaseStart + (i+1)*2;
+        unsigned int wb4 = wb3+1;
+        addTriangle(wb1, wb2, wb3);
+        addTriangle(wb3, wb2, wb4);
+    }
+}
+
+MeshData generateCandleMesh(const CandleParams &params, int segments, int wickSegments) {
+    int vertexCount, indexCount;
+    getCandleMeshSize(segments, wickSegments, vertexCount, indexCount);
+
+    MeshData mesh;
+    mesh.floatsPerVertex = 6;
+    mesh.vertices.resize((size_t)vertexCount * 6);
+    mesh.indices.resize(indexCount);
+    generateCandleMesh(params, segments, wickSegments, mesh.vertices.data(), mesh.indices.data(), 0);
+    return mesh;
+}
@@ -0,0 +1,193 @@
+#include "CurlNoise.h"
+#include "MeshFile.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+// Reference: Bridson, Hourihan, Nordenstam, "Curl-Noise for Procedural Fluid Flow", SIGGRAPH 2007
+
+// Bump when the noise changes, it invalidates cached fields
+static const uint32_t CURL_NOISE_VERSION = 1;
+static const uint32_t CURL_NOISE_FILE_MAGIC = 0x4C525543; // 'CURL'
+
+struct CurlNoiseFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t resolution;
+    uint32_t padding;
+};
+
+static float Fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static uint32_t HashLattice(int x, int y, int z, uint32_t seed) {
+    uint32_t h = seed ^ ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return h;
+}
+
+// Dot product with one of the 12 cube edge directions
+static float Gradient(uint32_t hash, float x, float y, float z) {
+    switch (hash % 12) {
+    case 0:  return  x + y;
+    case 1:  return -x + y;
+    case 2:  return  x - y;
+    case 3:  return -x - y;
+    case 4:  return  x + z;
+    case 5:  return -x + z;
+    case 6:  return  x - z;
+    case 7:  return -x - z;
+    case 8:  return  y + z;
+    case 9:  return -y + z;
+    case 10: return  y - z;
+    default: return -y - z;
+    }
+}
+
+// Gradient noise whose lattice wraps every period cells, so it tiles
+static float PeriodicNoise(const glm::vec3 &p, int period, uint32_t seed) {
+    glm::vec3 cell = glm::floor(p);
+    glm::vec3 f = p - cell;
+    int x0 = (int)cell.x, y0 = (int)cell.y, z0 = (int)cell.z;
+    auto wrap = [period](int i) { return ((i % period) + period) % period; };
+
+    float corners[8];
+    for (int c = 0; c < 8; c++) {
+        int dx = c & 1, dy = (c >> 1) & 1, dz = c >> 2;
+        uint32_t hash = HashLattice(wrap(x0 + dx), wrap(y0 + dy), wrap(z0 + dz), seed);
+        corners[c] = Gradient(hash, f.x - dx, f.y - dy, f.z - dz);
+    }
+    float u = Fade(f.x), v = Fade(f.y), w = Fade(f.z);
+    float x00 = corners[0] + (corners[1] - corners[0]) * u;
+    float x10 = corners[2] + (corners[3] - corners[2]) * u;
+    float x01 = corners[4] + (corners[5] - corners[4]) * u;
+    float x11 = corners[6] + (corners[7] - corners[6]) * u;
+    float xy0 = x00 + (x10 - x00) * v;
+    float xy1 = x01 + (x11 - x01) * v;
+    return xy0 + (xy1 - xy0) * w;
+}
+
+static uint64_t CurlNoiseKey(const CurlNoiseSettings &settings) {
+    uint64_t key = hashBytes(&CURL_NOISE_VERSION, sizeof(CURL_NOISE_VERSION));
+    return hashBytes(&settings, sizeof(settings), key);
+}
+
+CurlNoiseField::CurlNoiseField(ThreadPool &pool, const CurlNoiseSettings &settings)
+: resolution(std::max(settings.resolution, 4))
+{
+    uint64_t key = CurlNoiseKey(settings);
+    std::string cachePath = cacheFilePath("curl_noise", key, "curl");
+    CurlNoiseFileHeader header = { CURL_NOISE_FILE_MAGIC, CURL_NOISE_VERSION, key, (uint32_t)resolution, 0 };
+    velocity.resize((size_t)resolution * resolution * resolution * 3);
+    if (!readCacheFile(cachePath, &header, sizeof(header), velocity.data(), velocity.size() * sizeof(float))) {
+        build(pool, settings);
+        writeCacheFile(cachePath, &header, sizeof(header), velocity.data(), velocity.size() * sizeof(float));
+    }
+}
+
+void CurlNoiseField::build(ThreadPool &pool, const CurlNoiseSettings &settings) {
+    PROFILE_SCOPE("CurlNoiseField::build");
+    int n = resolution;
+    size_t cells = (size_t)n * n * n;
+    auto index = [n](int x, int y, int z) {
+        return ((size_t)(((z + n) % n) * n + ((y + n) % n)) * n + ((x + n) % n));
+    };
+
+    // Vector potential, three independent noises
+    std::vector<glm::vec3> potential(cells);
+    pool.parallelFor(n, 1, [&](int begin, int end) {
+        for (int z = begin; z < end; z++) {
+            for (int y = 0; y < n; y++) {
+                for (int x = 0; x < n; x++) {
+                    glm::vec3 q = glm::vec3((float)x, (float)y, (float)z) * ((float)settings.period / n);
+                    glm::vec3 psi(0.0f);
+                    float amplitude = 1.0f;
+                    int frequency = 1;
+                    for (int o = 0; o < settings.octaves; o++) {
+                        int period = settings.period * frequency;
+                        uint32_t seed = settings.seed + (uint32_t)o * 7919u;
+                        psi.x += amplitude * PeriodicNoise(q * (float)frequency, period, seed);
+                        psi.y += amplitude * PeriodicNoise(q * (float)frequency, period, seed + 1013u);
+                        psi.z += amplitude * PeriodicNoise(q * (float)frequency, period, seed + 2026u);
+                        amplitude *= 0.5f;
+                        frequency *= 2;
+                    }
+                    potential[index(x, y, z)] = psi;
+                }
+            }
+        }
+    });
+
+    // Curl by central differences; the grid wraps, so the result tiles too
+    velocity.resize(cells * 3);
+    std::vector<double> sliceEnergy(n, 0.0);
+    pool.parallelFor(n, 1, [&](int begin, int end) {
+        for (int z = begin; z < end; z++) {
+            double energy = 0.0;
+            for (int y = 0; y < n; y++) {
+                for (int x = 0; x < n; x++) {
+                    glm::vec3 dx = (potential[index(x + 1, y, z)] - potential[index(x - 1, y, z)]) * 0.5f;
+                    glm::vec3 dy = (potential[index(x, y + 1, z)] - potential[index(x, y - 1, z)]) * 0.5f;
+                    glm::vec3 dz = (potential[index(x, y, z + 1)] - potential[index(x, y, z - 1)]) * 0.5f;
+                    glm::vec3 curl(dy.z - dz.y, dz.x - dx.z, dx.y - dy.x);
+                    float *v = &velocity[index(x, y, z) * 3];
+                    v[0] = curl.x; v[1] = curl.y; v[2] = curl.z;
+                    energy += glm::dot(curl, curl);
+                }
+            }
+            sliceEnergy[z] = energy;
+        }
+    });
+
+    double energy = 0.0;
+    for (double e : sliceEnergy) {
+        energy += e;
+    }
+    float scale = energy > 0.0 ? (float)(1.0 / std::sqrt(energy / cells)) : 0.0f;
+    for (float &v : velocity) {
+        v *= scale;
+    }
+}
+
+glm::vec3 CurlNoiseField::sample(const glm::vec3 &p) const {
+    glm::vec3 v;
+    sample(&p.x, &p.y, &p.z, &v.x, &v.y, &v.z, 1);
+    return v;
+}
+
+void CurlNoiseField::sample(const float *x, const float *y, const float *z, float *vx, float *vy, float *vz,
+                            int count) const {
+    int n = resolution;
+    float fn = (float)n;
+    const float *grid = velocity.data();
+    for (int i = 0; i < count; i++) {
+        // Cell coordinates, wrapped into the tile
+        float gx = x[i] * fn, gy = y[i] * fn, gz = z[i] * fn;
+        float cx = std::floor(gx), cy = std::floor(gy), cz = std::floor(gz);
+        float fx = gx - cx, fy = gy - cy, fz = gz - cz;
+        int x0 = ((int)cx % n + n) % n, y0 = ((int)cy % n + n) % n, z0 = ((int)cz % n + n) % n;
+        int x1 = x0 + 1 == n ? 0 : x0 + 1;
+        int y1 = y0 + 1 == n ? 0 : y0 + 1;
+        int z1 = z0 + 1 == n ? 0 : z0 + 1;
+
+        size_t rows[4] = { ((size_t)z0 * n + y0) * n, ((size_t)z0 * n + y1) * n,
+                           ((size_t)z1 * n + y0) * n, ((size_t)z1 * n + y1) * n };
+        float wy[4] = { (1.0f - fy) * (1.0f - fz), fy * (1.0f - fz), (1.0f - fy) * fz, fy * fz };
+        float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+        for (int r = 0; r < 4; r++) {
+            const float *a = grid + (rows[r] + x0) * 3;
+            const float *b = grid + (rows[r] + x1) * 3;
+            float w0 = wy[r] * (1.0f - fx), w1 = wy[r] * fx;
+            sx += a[0] * w0 + b[0] * w1;
+            sy += a[1] * w0 + b[1] * w1;
+            sz += a[2] * w0 + b[2] * w1;
+        }
+        vx[i] = sx;
+        vy[i] = sy;
+        vz[i] = sz;
+    }
+}
@@ -0,0 +1,116 @@
+#include "DeferredRenderer.h"
+#include <iostream>
+
+DeferredRenderer::DeferredRenderer(int width, int height)
+: width(width), height(height), FBO(0), albedoTexture(0), normalTexture(0), bakedTexture(0), depthTexture(0), emptyVAO(0),
+  roomShader("shaders/room.vert", "shaders/gbuffer_room.frag"),
+  candleShader("shaders/candle.vert", "shaders/gbuffer_candle.frag"),
+  lightingShader("shaders/fullscreen.vert", "shaders/deferred_lighting.frag")
+{
+    glGenVertexArrays(1, &emptyVAO);
+    createTargets();
+}
+
+DeferredRenderer::~DeferredRenderer() {
+    destroyTargets();
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void DeferredRenderer::createTargets() {
+    auto makeTexture = [&](GLint internalFormat, GLenum format, GLenum type) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    };
+    albedoTexture = makeTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    normalTexture = makeTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+    bakedTexture = makeTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+    // Same format as the default depth buffer so the blit after lighting is allowed
+    depthTexture = makeTexture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, bakedTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glDrawBuffers(3, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "G-buffer framebuffer is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DeferredRenderer::destroyTargets() {
+    GLuint textures[4] = { albedoTexture, normalTexture, bakedTexture, depthTexture };
+    glDeleteTextures(4, textures);
+    glDeleteFramebuffers(1, &FBO);
+}
+
+void DeferredRenderer::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    destroyTargets();
+    createTargets();
+}
+
+void DeferredRenderer::beginGeometryPass() {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DeferredRenderer::lightingPass(const LightClusters &clusters, const glm::mat4 &view, const glm::mat4 &proj,
+                                    const glm::vec3 &viewPos, const ShadowAtlas &shadows,
+                                    GLuint targetFramebuffer) {
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    glViewport(0, 0, width, height);
+
+    // Every pixel is written exactly once, depth and blending are not needed
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    lightingShader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, albedoTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, normalTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, bakedTexture);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    lightingShader.setInt("gAlbedo", 0);
+    lightingShader.setInt("gNormal", 1);
+    lightingShader.setInt("gBaked", 2);
+    lightingShader.setInt("gDepth", 3);
+    lightingShader.setMat4("uInvViewProjection", glm::inverse(proj * view));
+    lightingShader.setVec3("viewPos", viewPos);
+    clusters.bind(lightingShader, 4, glm::vec2((float)width, (float)height));
+    shadows.bind(lightingShader, 7);
+
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+    if (blend) glEnable(GL_BLEND);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+}
@@ -0,0 +1,51 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution(const DynamicResolutionSettings &settings)
+: settings(settings), scale(settings.maxScale), gpuMs(0.0), cpuMs(0.0), hasSamples(false), cooldown(0) {}
+
+void DynamicResolution::reset() {
+    scale = settings.maxScale;
+    gpuMs = cpuMs = 0.0;
+    hasSamples = false;
+    cooldown = 0;
+}
+
+int DynamicResolution::scaledSize(int outputSize) const {
+    return std::max(1, (int)std::lround(outputSize * scale));
+}
+
+bool DynamicResolution::update(double gpuSample, double cpuSample) {
+    cpuMs = hasSamples ? cpuMs + (cpuSample - cpuMs) * settings.smoothing : cpuSample;
+    if (gpuSample >= 0.0) {
+        gpuMs = hasSamples ? gpuMs + (gpuSample - gpuMs) * settings.smoothing : gpuSample;
+        hasSamples = true;
+    }
+    if (!hasSamples || cooldown > 0) {
+        cooldown = std::max(cooldown - 1, 0);
+        return false;
+    }
+
+    // The scale is kept on whole steps below the maximum. GPU cost goes roughly with the pixel
+    // count, i.e. with scale^2, so when over budget jump towards the scale that would fit it,
+    // at most four steps at a time. Going back up is one step at a time.
+    int steps = (int)std::lround((settings.maxScale - scale) / settings.step);
+    int maxSteps = (int)std::floor((settings.maxScale - settings.minScale) / settings.step + 1e-3f);
+    double budget = settings.targetMs;
+    int newSteps = steps;
+    if (gpuMs > budget * settings.lowerAbove && cpuMs < budget) {
+        double ideal = scale * std::sqrt(budget * settings.lowerAbove / gpuMs);
+        int idealSteps = (int)std::ceil((settings.maxScale - ideal) / settings.step - 1e-3);
+        newSteps = std::min(std::max(idealSteps, steps + 1), steps + 4);
+    } else if (gpuMs < budget * settings.raiseBelow) {
+        newSteps = steps - 1;
+    }
+    newSteps = std::min(std::max(newSteps, 0), maxSteps);
+    if (newSteps == steps) {
+        return false;
+    }
+    scale = settings.maxScale - newSteps * settings.step;
+    cooldown = settings.cooldownFrames;
+    return true;
+}
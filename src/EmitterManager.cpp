@@ -0,0 +1,90 @@
+#include "EmitterManager.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+EmitterManager::EmitterManager(const EmitterLodSettings &settings)
+: settings(settings), budgetScale(1.0f)
+{}
+
+int EmitterManager::add(ParticleEmitter *emitter, float emissionRate) {
+    Entry entry;
+    entry.emitter = emitter;
+    entry.emissionRate = emissionRate;
+    entry.screenSize = settings.fullDetailSize;
+    entry.detail = 1.0f;
+    entry.carry = 0.0f;
+    entry.pending = 0.0f;
+    entry.wasVisible = false; // so the first update warms the flame up
+    entries.push_back(entry);
+    return (int)entries.size() - 1;
+}
+
+void EmitterManager::reset() {
+    for (Entry &entry : entries) {
+        entry.screenSize = settings.fullDetailSize;
+        entry.detail = 1.0f;
+        entry.carry = 0.0f;
+        entry.pending = 0.0f;
+        entry.wasVisible = false;
+    }
+    budgetScale = 1.0f;
+}
+
+void EmitterManager::setScreenSize(int index, float projectedRadius) {
+    entries[index].screenSize = std::max(projectedRadius, 0.0f);
+}
+
+int EmitterManager::getLiveParticles() const {
+    int live = 0;
+    for (const Entry &entry : entries) {
+        live += entry.emitter->getLiveCount();
+    }
+    return live;
+}
+
+void EmitterManager::tick(Entry &entry, float rate, float dt) {
+    entry.carry += rate * dt;
+    int count = (int)entry.carry;
+    entry.carry -= count;
+    entry.emitter->emit(count);
+    entry.emitter->update(dt);
+}
+
+void EmitterManager::update(float dt) {
+    PROFILE_SCOPE("EmitterManager::update");
+
+    // Detail from the screen size, then one scale for everybody if the limits overshoot the budget
+    float wanted = 0.0f;
+    for (Entry &entry : entries) {
+        float detail = entry.screenSize / std::max(settings.fullDetailSize, 1.0f);
+        entry.detail = glm::clamp(detail, settings.minDetail, 1.0f);
+        wanted += entry.emitter->getMaxParticles() * entry.detail;
+    }
+    budgetScale = wanted > settings.particleBudget ? settings.particleBudget / wanted : 1.0f;
+
+    for (Entry &entry : entries) {
+        entry.emitter->setParticleLimit((int)(entry.emitter->getMaxParticles() * entry.detail * budgetScale));
+        float rate = entry.emissionRate * entry.detail;
+
+        bool visible = entry.screenSize > 0.0f;
+        if (visible && !entry.wasVisible) {
+            // Whatever the coarse hidden ticks left behind is replaced by a proper history
+            entry.emitter->clear();
+            int steps = (int)std::ceil(settings.warmupTime / settings.warmupStep);
+            for (int i = 0; i < steps; i++) {
+                tick(entry, rate, settings.warmupStep);
+            }
+            entry.pending = 0.0f;
+        }
+        entry.wasVisible = visible;
+
+        entry.pending += dt;
+        float interval = visible ? (1.0f - entry.detail) / settings.lowDetailTickRate
+                                 : 1.0f / settings.hiddenTickRate;
+        if (entry.pending >= interval) {
+            tick(entry, rate, entry.pending);
+            entry.pending = 0.0f;
+        }
+    }
+}
@@ -0,0 +1,294 @@
+#include "FlameFluid.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FLUID_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// Reference: Stam, "Stable Fluids", SIGGRAPH 1999; Fedkiw, Stam, Jensen, "Visual Simulation of Smoke", SIGGRAPH 2001
+
+FlameFluid::FlameFluid(const FluidSettings &settings)
+: settings(settings), rng(settings.seed), windX(0.0f), windZ(0.0f)
+{
+    this->settings.sizeX = std::max(settings.sizeX, 4);
+    this->settings.sizeY = std::max(settings.sizeY, 4);
+    this->settings.sizeZ = std::max(settings.sizeZ, 4);
+    strideY = this->settings.sizeX + 2;
+    strideZ = strideY * (this->settings.sizeY + 2);
+    size_t cells = (size_t)strideZ * (this->settings.sizeZ + 2);
+    for (std::vector<float> *field : { &u, &v, &w, &density, &temperature, &pressure, &divergence,
+                                       &scratch[0], &scratch[1], &scratch[2] }) {
+        field->assign(cells, 0.0f);
+    }
+}
+
+void FlameFluid::reset() {
+    for (std::vector<float> *field : { &u, &v, &w, &density, &temperature, &pressure }) {
+        std::fill(field->begin(), field->end(), 0.0f);
+    }
+    rng.seed(settings.seed);
+    windX = windZ = 0.0f;
+}
+
+glm::vec3 FlameFluid::getWorldSize() const {
+    return glm::vec3((float)settings.sizeX, (float)settings.sizeY, (float)settings.sizeZ) * settings.cellSize;
+}
+
+glm::vec3 FlameFluid::getSourceOffset() const {
+    return glm::vec3(settings.sizeX * 0.5f, settings.sourceHeight, settings.sizeZ * 0.5f) * settings.cellSize;
+}
+
+template <typename Fn>
+void FlameFluid::forSlabs(ThreadPool *pool, const Fn &fn) {
+    int slabs = settings.sizeZ;
+    if (pool) {
+        pool->parallelFor(slabs, 1, [&](int begin, int end) { fn(begin + 1, end + 1); });
+    } else {
+        fn(1, slabs + 1);
+    }
+}
+
+void FlameFluid::step(float dt, ThreadPool *pool) {
+    PROFILE_SCOPE("FlameFluid::step");
+    if (dt <= 0.0f) {
+        return;
+    }
+    addSources(dt);
+    applyForces(dt, pool);
+
+    // Velocity carries itself, then loses its divergence
+    advect(dt, u, scratch[0], 1.0f, pool);
+    advect(dt, v, scratch[1], 1.0f, pool);
+    advect(dt, w, scratch[2], 1.0f, pool);
+    u.swap(scratch[0]);
+    v.swap(scratch[1]);
+    w.swap(scratch[2]);
+    copyBoundary(u);
+    verticalVelocityBoundary(v);
+    copyBoundary(w);
+    project(pool);
+
+    advect(dt, density, scratch[0], std::exp(-settings.smokeFade * dt), pool);
+    density.swap(scratch[0]);
+    zeroBoundary(density);
+    advect(dt, temperature, scratch[0], std::exp(-settings.cooling * dt), pool);
+    temperature.swap(scratch[0]);
+    zeroBoundary(temperature);
+}
+
+void FlameFluid::addSources(float dt) {
+    // The burning zone: full heat and smoke, pushed up and drifting sideways so the flame
+    // flickers. The drift is low passed noise (it wanders instead of buzzing) whose spread
+    // stays at flicker whatever the step size.
+    std::normal_distribution<float> jitter(0.0f, 1.0f);
+    float follow = std::min(settings.flickerRate * dt, 1.0f);
+    float kick = settings.flicker * std::sqrt(follow * (2.0f - follow));
+    windX += -windX * follow + jitter(rng) * kick;
+    windZ += -windZ * follow + jitter(rng) * kick;
+    float cx = settings.sizeX * 0.5f + 0.5f, cy = settings.sourceHeight + 0.5f, cz = settings.sizeZ * 0.5f + 0.5f;
+    float r = settings.sourceRadius;
+    int x0 = std::max(1, (int)std::floor(cx - r)), x1 = std::min(settings.sizeX, (int)std::ceil(cx + r));
+    int y0 = std::max(1, (int)std::floor(cy - r)), y1 = std::min(settings.sizeY, (int)std::ceil(cy + r));
+    int z0 = std::max(1, (int)std::floor(cz - r)), z1 = std::min(settings.sizeZ, (int)std::ceil(cz + r));
+    for (int z = z0; z <= z1; z++) {
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                float dx = x - cx, dy = y - cy, dz = z - cz;
+                if (dx * dx + dy * dy + dz * dz > r * r) {
+                    continue;
+                }
+                size_t i = index(x, y, z);
+                density[i] = std::max(density[i], 1.0f);
+                temperature[i] = std::max(temperature[i], 1.0f);
+                v[i] = std::max(v[i], settings.sourceSpeed);
+                u[i] = windX;
+                w[i] = windZ;
+            }
+        }
+    }
+}
+
+void FlameFluid::applyForces(float dt, ThreadPool *pool) {
+    float lift = settings.buoyancy * dt, weight = settings.smokeWeight * dt;
+    forSlabs(pool, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; z++) {
+            for (int y = 1; y <= settings.sizeY; y++) {
+                size_t row = index(0, y, z);
+                for (int x = 1; x <= settings.sizeX; x++) {
+                    v[row + x] += lift * temperature[row + x] - weight * density[row + x];
+                }
+            }
+        }
+    });
+}
+
+float FlameFluid::sampleField(const std::vector<float> &field, float x, float y, float z) const {
+    // Cell centers sit at integer coordinates, ghosts included; stay inside the ghost layer
+    x = std::min(std::max(x, 0.0f), settings.sizeX + 1.0f - 1e-3f);
+    y = std::min(std::max(y, 0.0f), settings.sizeY + 1.0f - 1e-3f);
+    z = std::min(std::max(z, 0.0f), settings.sizeZ + 1.0f - 1e-3f);
+    int x0 = (int)x, y0 = (int)y, z0 = (int)z;
+    float fx = x - x0, fy = y - y0, fz = z - z0;
+    const float *c = &field[index(x0, y0, z0)];
+    float c00 = c[0] + (c[1] - c[0]) * fx;
+    float c10 = c[strideY] + (c[strideY + 1] - c[strideY]) * fx;
+    float c01 = c[strideZ] + (c[strideZ + 1] - c[strideZ]) * fx;
+    float c11 = c[strideZ + strideY] + (c[strideZ + strideY + 1] - c[strideZ + strideY]) * fx;
+    float c0 = c00 + (c10 - c00) * fy;
+    float c1 = c01 + (c11 - c01) * fy;
+    return c0 + (c1 - c0) * fz;
+}
+
+void FlameFluid::advect(float dt, const std::vector<float> &src, std::vector<float> &dst, float decay,
+                        ThreadPool *pool) {
+    // Semi-Lagrangian: every cell takes the value found one step back along the flow
+    forSlabs(pool, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; z++) {
+            for (int y = 1; y <= settings.sizeY; y++) {
+                size_t row = index(0, y, z);
+                for (int x = 1; x <= settings.sizeX; x++) {
+                    size_t i = row + x;
+                    float value = sampleField(src, x - dt * u[i], y - dt * v[i], z - dt * w[i]);
+                    dst[i] = value * decay;
+                }
+            }
+        }
+    });
+}
+
+void FlameFluid::project(ThreadPool *pool) {
+    forSlabs(pool, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; z++) {
+            for (int y = 1; y <= settings.sizeY; y++) {
+                size_t row = index(0, y, z);
+                for (int x = 1; x <= settings.sizeX; x++) {
+                    size_t i = row + x;
+                    divergence[i] = 0.5f * (u[i + 1] - u[i - 1] + v[i + strideY] - v[i - strideY]
+                                            + w[i + strideZ] - w[i - strideZ]);
+                }
+            }
+        }
+    });
+
+    // Jacobi sweeps for laplacian(p) = divergence, starting from last step's pressure.
+    // Rows are contiguous in x, so four cells go at once with unaligned loads.
+    std::vector<float> &next = scratch[0];
+    pressureBoundary(pressure);
+    for (int iteration = 0; iteration < settings.pressureIterations; iteration++) {
+        forSlabs(pool, [&](int zBegin, int zEnd) {
+            for (int z = zBegin; z < zEnd; z++) {
+                for (int y = 1; y <= settings.sizeY; y++) {
+                    size_t row = index(1, y, z);
+                    const float *p = &pressure[row];
+                    const float *div = &divergence[row];
+                    float *out = &next[row];
+                    int x = 0;
+#ifdef FLUID_SSE
+                    const __m128 sixth = _mm_set1_ps(1.0f / 6.0f);
+                    for (; x + 4 <= settings.sizeX; x += 4) {
+                        __m128 sum = _mm_add_ps(_mm_loadu_ps(p + x - 1), _mm_loadu_ps(p + x + 1));
+                        sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(p + x - strideY), _mm_loadu_ps(p + x + strideY)));
+                        sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(p + x - strideZ), _mm_loadu_ps(p + x + strideZ)));
+                        _mm_storeu_ps(out + x, _mm_mul_ps(_mm_sub_ps(sum, _mm_loadu_ps(div + x)), sixth));
+                    }
+#endif
+                    for (; x < settings.sizeX; x++) {
+                        float sum = p[x - 1] + p[x + 1] + p[x - strideY] + p[x + strideY] + p[x - strideZ] + p[x + strideZ];
+                        out[x] = (sum - div[x]) * (1.0f / 6.0f);
+                    }
+                }
+            }
+        });
+        pressure.swap(next);
+        pressureBoundary(pressure);
+    }
+
+    forSlabs(pool, [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; z++) {
+            for (int y = 1; y <= settings.sizeY; y++) {
+                size_t row = index(0, y, z);
+                for (int x = 1; x <= settings.sizeX; x++) {
+                    size_t i = row + x;
+                    u[i] -= 0.5f * (pressure[i + 1] - pressure[i - 1]);
+                    v[i] -= 0.5f * (pressure[i + strideY] - pressure[i - strideY]);
+                    w[i] -= 0.5f * (pressure[i + strideZ] - pressure[i - strideZ]);
+                }
+            }
+        }
+    });
+    copyBoundary(u);
+    verticalVelocityBoundary(v);
+    copyBoundary(w);
+}
+
+// Ghost cells. The six faces are set in x, y, z order so edges and corners end up defined.
+template <typename Fn>
+static void ForEachGhost(int sizeX, int sizeY, int sizeZ, int strideY, int strideZ, const Fn &fn) {
+    // fn(ghost index, inner neighbour index, face): faces 0/1 = -x/+x, 2/3 = -y/+y, 4/5 = -z/+z
+    for (int z = 0; z <= sizeZ + 1; z++) {
+        for (int y = 0; y <= sizeY + 1; y++) {
+            size_t row = (size_t)z * strideZ + (size_t)y * strideY;
+            fn(row, row + 1, 0);
+            fn(row + sizeX + 1, row + sizeX, 1);
+        }
+    }
+    for (int z = 0; z <= sizeZ + 1; z++) {
+        for (int x = 0; x <= sizeX + 1; x++) {
+            size_t bottom = (size_t)z * strideZ + x, top = bottom + (size_t)(sizeY + 1) * strideY;
+            fn(bottom, bottom + strideY, 2);
+            fn(top, top - strideY, 3);
+        }
+    }
+    for (int y = 0; y <= sizeY + 1; y++) {
+        for (int x = 0; x <= sizeX + 1; x++) {
+            size_t front = (size_t)y * strideY + x, back = front + (size_t)(sizeZ + 1) * strideZ;
+            fn(front, front + strideZ, 4);
+            fn(back, back - strideZ, 5);
+        }
+    }
+}
+
+void FlameFluid::copyBoundary(std::vector<float> &field) const {
+    float *f = field.data();
+    ForEachGhost(settings.sizeX, settings.sizeY, settings.sizeZ, strideY, strideZ,
+                 [f](size_t ghost, size_t inner, int) { f[ghost] = f[inner]; });
+}
+
+void FlameFluid::verticalVelocityBoundary(std::vector<float> &field) const {
+    // Mirrored at the floor, so the velocity through it is zero; copied on the open faces
+    float *f = field.data();
+    ForEachGhost(settings.sizeX, settings.sizeY, settings.sizeZ, strideY, strideZ,
+                 [f](size_t ghost, size_t inner, int face) { f[ghost] = face == 2 ? -f[inner] : f[inner]; });
+}
+
+void FlameFluid::zeroBoundary(std::vector<float> &field) const {
+    float *f = field.data();
+    ForEachGhost(settings.sizeX, settings.sizeY, settings.sizeZ, strideY, strideZ,
+                 [f](size_t ghost, size_t, int) { f[ghost] = 0.0f; });
+}
+
+void FlameFluid::pressureBoundary(std::vector<float> &field) const {
+    // Zero gradient at the floor (nothing flows through it), zero pressure on the open faces
+    float *f = field.data();
+    ForEachGhost(settings.sizeX, settings.sizeY, settings.sizeZ, strideY, strideZ,
+                 [f](size_t ghost, size_t inner, int face) { f[ghost] = face == 2 ? f[inner] : 0.0f; });
+}
+
+void FlameFluid::writeVolume(std::vector<uint8_t> &texels) const {
+    texels.resize((size_t)getCellCount() * 2);
+    uint8_t *out = texels.data();
+    for (int z = 1; z <= settings.sizeZ; z++) {
+        for (int y = 1; y <= settings.sizeY; y++) {
+            size_t row = index(0, y, z);
+            for (int x = 1; x <= settings.sizeX; x++) {
+                float d = std::min(std::max(density[row + x], 0.0f), 1.0f);
+                float t = std::min(std::max(temperature[row + x], 0.0f), 1.0f);
+                *out++ = (uint8_t)(d * 255.0f + 0.5f);
+                *out++ = (uint8_t)(t * 255.0f + 0.5f);
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#include "FlameLight.h"
+#include <algorithm>
+#include <cmath>
+
+FlameLight::FlameLight(const FlameLightSettings &settings)
+: settings(settings), started(false), averageLive(0.0f), averageHeight(0.0f), averageAge(0.0f),
+  position(0.0f), intensity(1.0f), ageOffset(0.0f)
+{
+}
+
+void FlameLight::update(const EmitterStats &stats, const glm::vec3 &flamePos, float dt) {
+    glm::vec3 offset = stats.centroid - flamePos;
+    if (!started) {
+        averageLive = (float)stats.liveCount;
+        averageHeight = offset.y;
+        averageAge = stats.meanAge;
+        started = true;
+    }
+    float follow = 1.0f - std::exp(-settings.averageRate * dt);
+    averageLive += ((float)stats.liveCount - averageLive) * follow;
+    averageHeight += (offset.y - averageHeight) * follow;
+    averageAge += (stats.meanAge - averageAge) * follow;
+
+    float liveChange = averageLive > 0.5f ? stats.liveCount / averageLive - 1.0f : 0.0f;
+    intensity = 1.0f + settings.liveGain * liveChange + settings.heightGain * (offset.y - averageHeight);
+    intensity = std::min(std::max(intensity, settings.minIntensity), settings.maxIntensity);
+    ageOffset = stats.liveCount > 0 ? stats.meanAge - averageAge : 0.0f;
+
+    glm::vec2 side = glm::vec2(offset.x, offset.z) * settings.followFraction;
+    float sideLength = std::sqrt(side.x * side.x + side.y * side.y);
+    if (sideLength > settings.maxOffset) {
+        side = side * (settings.maxOffset / sideLength);
+    }
+    position = flamePos + glm::vec3(side.x, 0.0f, side.y);
+}
+
+glm::vec3 FlameLight::getColor(const glm::vec3 &baseColor) const {
+    // Green and blue drop first as the flame cools, red stays
+    float cool = std::min(std::max(ageOffset * settings.ageGain, -0.5f), 0.5f);
+    return baseColor * glm::vec3(1.0f, 1.0f - cool, 1.0f - 2.0f * cool);
+}
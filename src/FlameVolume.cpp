@@ -0,0 +1,191 @@
+#include "FlameVolume.h"
+#include <algorithm>
+#include <cmath>
+
+// Unit cube, corner i at (i & 1, (i >> 1) & 1, (i >> 2) & 1), faces wound counter-clockwise
+// seen from outside
+static const float BOX_VERTICES[] = {
+    0, 0, 0,  1, 0, 0,  0, 1, 0,  1, 1, 0,
+    0, 0, 1,  1, 0, 1,  0, 1, 1,  1, 1, 1,
+};
+static const uint16_t BOX_INDICES[] = {
+    0, 4, 6,  0, 6, 2,   1, 3, 7,  1, 7, 5,   // -x, +x
+    0, 1, 5,  0, 5, 4,   2, 6, 7,  2, 7, 3,   // -y, +y
+    0, 2, 3,  0, 3, 1,   4, 5, 7,  4, 7, 6,   // -z, +z
+};
+
+// Piecewise gaussian lobe of the CIE fit below
+static double Lobe(double x, double mean, double sigmaBelow, double sigmaAbove) {
+    double t = (x - mean) / (x < mean ? sigmaBelow : sigmaAbove);
+    return std::exp(-0.5 * t * t);
+}
+
+// CIE 1931 matching functions, multi-lobe fit from Wyman, Sloan, Shirley, "Simple Analytic
+// Approximations to the CIE XYZ Color Matching Functions", JCGT 2013. nm in, XYZ out.
+static glm::dvec3 CieMatch(double nm) {
+    double x = 1.056 * Lobe(nm, 599.8, 37.9, 31.0) + 0.362 * Lobe(nm, 442.0, 16.0, 26.7)
+             - 0.065 * Lobe(nm, 501.1, 20.4, 26.2);
+    double y = 0.821 * Lobe(nm, 568.8, 46.9, 40.5) + 0.286 * Lobe(nm, 530.9, 16.3, 31.1);
+    double z = 1.217 * Lobe(nm, 437.0, 11.8, 36.0) + 0.681 * Lobe(nm, 459.0, 26.0, 13.8);
+    return glm::dvec3(x, y, z);
+}
+
+// XYZ of a black body's visible radiance (Planck's law), up to a constant factor
+static glm::dvec3 BlackbodyXyz(double kelvin) {
+    const double c2 = 1.4387769e-2; // hc/k, m K
+    glm::dvec3 xyz(0.0);
+    for (double nm = 380.0; nm <= 780.0; nm += 5.0) {
+        double lambda = nm * 1e-9;
+        double radiance = 1.0 / (std::pow(lambda, 5.0) * (std::exp(c2 / (lambda * kelvin)) - 1.0));
+        xyz += CieMatch(nm) * radiance;
+    }
+    return xyz;
+}
+
+FlameVolumeRenderer::FlameVolumeRenderer(BufferArena &arena, int count, int sizeX, int sizeY, int sizeZ,
+                                         const FlameVolumeSettings &settings)
+: arena(arena), settings(settings), sizeX(sizeX), sizeY(sizeY), sizeZ(sizeZ), textures(count, 0),
+  blackbodyTexture(0), shader("shaders/flame_volume.vert", "shaders/flame_volume.frag"),
+  lastCost(0.0f), sampleRate(1.0f)
+{
+    VertexLayout layout;
+    layout.stride = 3 * sizeof(float);
+    layout.attributes = { {0, 3, 0} };
+    box = arena.allocateMesh(layout, BOX_VERTICES, 8, BOX_INDICES, 36, 2);
+
+    // Linear filtering smooths the grid; clamp so the march never wraps to the other side
+    glGenTextures(count, textures.data());
+    for (GLuint texture : textures) {
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RG8, sizeX, sizeY, sizeZ, 0, GL_RG, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_3D, 0);
+    buildBlackbodyLut();
+}
+
+FlameVolumeRenderer::~FlameVolumeRenderer() {
+    glDeleteTextures((GLsizei)textures.size(), textures.data());
+    glDeleteTextures(1, &blackbodyTexture);
+    arena.freeMesh(box);
+}
+
+void FlameVolumeRenderer::upload(int index, const std::vector<uint8_t> &texels) {
+    if (texels.size() != (size_t)sizeX * sizeY * sizeZ * 2) {
+        return;
+    }
+    // Rows of two byte texels are not 4 byte aligned for odd widths
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_3D, textures[index]);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, sizeX, sizeY, sizeZ, GL_RG, GL_UNSIGNED_BYTE, texels.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void FlameVolumeRenderer::buildBlackbodyLut() {
+    // Linear sRGB emission from minKelvin to maxKelvin, scaled so the hottest entry has a
+    // luminance of 1. Cool entries come out nearly black on their own, no cutoff needed.
+    int size = std::max(settings.lutSize, 2);
+    double peak = BlackbodyXyz(settings.maxKelvin).y;
+    std::vector<float> texels((size_t)size * 3);
+    for (int i = 0; i < size; i++) {
+        double kelvin = settings.minKelvin + (settings.maxKelvin - settings.minKelvin) * i / (size - 1);
+        glm::dvec3 xyz = BlackbodyXyz(kelvin) / peak;
+        double r =  3.2406 * xyz.x - 1.5372 * xyz.y - 0.4986 * xyz.z;
+        double g = -0.9689 * xyz.x + 1.8758 * xyz.y + 0.0415 * xyz.z;
+        double b =  0.0557 * xyz.x - 0.2040 * xyz.y + 1.0570 * xyz.z;
+        texels[i * 3 + 0] = (float)std::max(r, 0.0);
+        texels[i * 3 + 1] = (float)std::max(g, 0.0);
+        texels[i * 3 + 2] = (float)std::max(b, 0.0);
+    }
+
+    glGenTextures(1, &blackbodyTexture);
+    glBindTexture(GL_TEXTURE_1D, blackbodyTexture);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB16F, size, 0, GL_RGB, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_1D, 0);
+}
+
+void FlameVolumeRenderer::add(int index, const glm::vec3 &boxMin, const glm::vec3 &boxSize) {
+    queued.push_back({index, boxMin, boxSize});
+}
+
+void FlameVolumeRenderer::render(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec3 &cameraPos,
+                                 const glm::vec2 &screenSize) {
+    // Footprint: screen rectangle of the projected box, a flame reaching behind the camera
+    // counts as the whole screen. Each pixel marches about one sample per cell crossed.
+    glm::mat4 viewProj = proj * view;
+    float raySamples = (sizeX + sizeY + sizeZ) / 3.0f;
+    double cost = 0.0;
+    for (const QueuedFlame &flame : queued) {
+        glm::vec2 lo(1.0f), hi(-1.0f);
+        bool behind = false;
+        for (int corner = 0; corner < 8 && !behind; corner++) {
+            glm::vec3 offset((float)(corner & 1), (float)((corner >> 1) & 1), (float)(corner >> 2));
+            glm::vec4 clip = viewProj * glm::vec4(flame.boxMin + offset * flame.boxSize, 1.0f);
+            if (clip.w <= 1e-3f) {
+                behind = true;
+                break;
+            }
+            glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+            lo = glm::min(lo, ndc);
+            hi = glm::max(hi, ndc);
+        }
+        if (behind) {
+            lo = glm::vec2(-1.0f);
+            hi = glm::vec2(1.0f);
+        }
+        glm::vec2 extent = glm::max(glm::min(hi, glm::vec2(1.0f)) - glm::max(lo, glm::vec2(-1.0f)), glm::vec2(0.0f));
+        cost += (double)extent.x * extent.y * 0.25 * screenSize.x * screenSize.y * raySamples;
+    }
+    lastCost = (float)(cost * 1e-6);
+    sampleRate = 1.0f;
+    if (cost > settings.sampleBudget * 1e6) {
+        sampleRate = std::max((float)(settings.sampleBudget * 1e6 / cost), settings.minSampleRate);
+    }
+    if (queued.empty()) {
+        return;
+    }
+
+    shader.use();
+    shader.setMat4("uView", view);
+    shader.setMat4("uProjection", proj);
+    shader.setVec3("uCameraPos", cameraPos);
+    shader.setIVec3("uGridSize", sizeX, sizeY, sizeZ);
+    shader.setFloat("uSampleRate", sampleRate);
+    shader.setInt("uMaxSteps", settings.maxSteps);
+    shader.setFloat("uOpacityCutoff", settings.opacityCutoff);
+    shader.setFloat("uEmptySkip", std::max(settings.emptySkip, 1.0f));
+    shader.setFloat("uLutSize", (float)std::max(settings.lutSize, 2));
+    shader.setInt("uVolume", 0);
+    shader.setInt("uBlackbody", 1);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, blackbodyTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Front faces only, so every pixel marches once; tested against the scene, never written
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glDepthMask(GL_FALSE);
+    glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
+    for (const QueuedFlame &flame : queued) {
+        shader.setVec3("uBoxMin", flame.boxMin);
+        shader.setVec3("uBoxSize", flame.boxSize);
+        glBindTexture(GL_TEXTURE_3D, textures[flame.index]);
+        arena.drawElements(box, GL_TRIANGLES, box.indexCount());
+    }
+
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_CULL_FACE);
+}
@@ -0,0 +1,136 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+FramePacer::FramePacer(const FramePacerSettings &settings)
+: settings(settings), activeVsync(VsyncMode::Off), hasDeadline(false), inputTime(Clock::now())
+{
+#ifdef _WIN32
+    // Plain Sleep() has a 15.6 ms granularity by default, the high resolution timer (Windows 10
+    // 1803+) gets well under a millisecond without changing the system wide timer rate
+    timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+}
+
+FramePacer::~FramePacer() {
+    for (PendingFrame &frame : pending) {
+        glDeleteSync(frame.fence);
+    }
+#ifdef _WIN32
+    if (timer) {
+        CloseHandle((HANDLE)timer);
+    }
+#endif
+}
+
+VsyncMode FramePacer::applyVsync() {
+    activeVsync = settings.vsync;
+    if (activeVsync == VsyncMode::Adaptive &&
+        !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+        !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+        activeVsync = VsyncMode::On;
+    }
+    glfwSwapInterval(activeVsync == VsyncMode::Adaptive ? -1 : activeVsync == VsyncMode::On ? 1 : 0);
+    return activeVsync;
+}
+
+void FramePacer::sleepUntil(Clock::time_point deadline) {
+    auto spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(settings.spinMs));
+    auto wakeUp = deadline - spin;
+    auto now = Clock::now();
+    if (wakeUp > now) {
+#ifdef _WIN32
+        if (timer) {
+            // Relative due time in 100 ns units
+            LARGE_INTEGER due;
+            due.QuadPart = -(LONGLONG)(std::chrono::duration_cast<std::chrono::nanoseconds>(wakeUp - now).count() / 100);
+            SetWaitableTimer((HANDLE)timer, &due, 0, NULL, NULL, FALSE);
+            WaitForSingleObject((HANDLE)timer, INFINITE);
+        } else {
+            std::this_thread::sleep_until(wakeUp);
+        }
+#else
+        std::this_thread::sleep_until(wakeUp);
+#endif
+    }
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+void FramePacer::waitForNextFrame() {
+    if (settings.targetFps <= 0.0) {
+        hasDeadline = false;
+        return;
+    }
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / settings.targetFps));
+    auto now = Clock::now();
+    if (!hasDeadline) {
+        nextDeadline = now;
+        hasDeadline = true;
+    }
+    // Fell more than a frame behind (a hitch, the window was dragged): restart the cadence
+    // from now instead of racing through frames to catch up
+    if (now - nextDeadline > period) {
+        nextDeadline = now;
+    }
+    sleepUntil(nextDeadline);
+    nextDeadline += period;
+}
+
+void FramePacer::markInput() {
+    inputTime = Clock::now();
+}
+
+void FramePacer::presented() {
+    auto now = Clock::now();
+    push(swapLatencies, std::chrono::duration<double, std::milli>(now - inputTime).count());
+
+    // Collect the frames the GPU has finished since last time, in order
+    size_t done = 0;
+    for (; done < pending.size(); done++) {
+        GLenum status = glClientWaitSync(pending[done].fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        push(presentLatencies, std::chrono::duration<double, std::milli>(now - pending[done].input).count());
+        glDeleteSync(pending[done].fence);
+    }
+    pending.erase(pending.begin(), pending.begin() + done);
+
+    // A stuck driver should not grow this forever
+    if (pending.size() >= 8) {
+        glDeleteSync(pending.front().fence);
+        pending.erase(pending.begin());
+    }
+    pending.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), inputTime});
+    glFlush(); // so the fence gets to the GPU without waiting for the next frame's commands
+}
+
+double FramePacer::average(const std::deque<double> &values) {
+    double total = 0.0;
+    for (double value : values) {
+        total += value;
+    }
+    return values.empty() ? 0.0 : total / values.size();
+}
+
+double FramePacer::getMaxPresentLatencyMs() const {
+    return presentLatencies.empty() ? 0.0 : *std::max_element(presentLatencies.begin(), presentLatencies.end());
+}
+
+void FramePacer::push(std::deque<double> &values, double value) {
+    values.push_back(value);
+    if (values.size() > LATENCY_HISTORY) {
+        values.pop_front();
+    }
+}
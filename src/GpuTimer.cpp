@@ -0,0 +1,154 @@
+#include "GpuTimer.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+GpuTimer::GpuTimer(int latency, int history)
+: frames(latency > 1 ? latency : 2), current(0), historySize(history > 1 ? history : 1),
+  frameIndex(0), csv(nullptr) {}
+
+GpuTimer::~GpuTimer() {
+    for (Frame &frame : frames) {
+        if (!frame.queries.empty()) {
+            glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+        }
+    }
+}
+
+int GpuTimer::findSection(const std::string &name) const {
+    for (size_t i = 0; i < sections.size(); i++) {
+        if (sections[i].name == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int GpuTimer::findOrAddSection(const std::string &name) {
+    int existing = findSection(name);
+    if (existing >= 0) {
+        return existing;
+    }
+    Section section;
+    section.name = name;
+    section.history.reserve(historySize);
+    sections.push_back(section);
+    return (int)sections.size() - 1;
+}
+
+GLuint GpuTimer::nextQuery(Frame &frame) {
+    if (frame.used == frame.queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    return frame.queries[frame.used++];
+}
+
+void GpuTimer::beginFrame() {
+    current = (current + 1) % (int)frames.size();
+    Frame &frame = frames[current];
+
+    // This slot was issued frames.size() - 1 frames ago. If the driver is still behind we
+    // drop the samples rather than wait.
+    bool available = true;
+    if (frame.used > 0) {
+        // Queries complete in order, the last one issued decides for all of them
+        GLint ready = 0;
+        glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &ready);
+        available = ready != 0;
+    }
+    for (const Pending &pending : frame.pending) {
+        if (!available || pending.end == 0) {
+            continue;
+        }
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(pending.start, GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(pending.end, GL_QUERY_RESULT, &end);
+        Section &section = sections[pending.section];
+        section.lastMs = (end - start) / 1.0e6;
+        section.samples++;
+        if (section.history.size() < historySize) {
+            section.history.push_back((float)section.lastMs);
+        } else {
+            section.history[section.historyNext] = (float)section.lastMs;
+        }
+        section.historyNext = (section.historyNext + 1) % historySize;
+        if (csv) {
+            *csv << frame.index << "," << section.name << "," << section.lastMs << "\n";
+        }
+    }
+    frame.pending.clear();
+    frame.used = 0;
+    frame.index = frameIndex++;
+    std::fill(frame.open.begin(), frame.open.end(), -1);
+}
+
+void GpuTimer::begin(const std::string &name) {
+    Frame &frame = frames[current];
+    int section = findOrAddSection(name);
+    if ((int)frame.open.size() < (int)sections.size()) {
+        frame.open.resize(sections.size(), -1);
+    }
+    GLuint query = nextQuery(frame);
+    glQueryCounter(query, GL_TIMESTAMP);
+    frame.open[section] = (int)frame.pending.size();
+    frame.pending.push_back({section, query, 0});
+}
+
+void GpuTimer::end(const std::string &name) {
+    Frame &frame = frames[current];
+    int section = findOrAddSection(name);
+    if (section >= (int)frame.open.size() || frame.open[section] < 0) {
+        return; // end() without begin()
+    }
+    GLuint query = nextQuery(frame);
+    glQueryCounter(query, GL_TIMESTAMP);
+    frame.pending[frame.open[section]].end = query;
+    frame.open[section] = -1;
+}
+
+double GpuTimer::getAverageMs(int section) const {
+    const std::vector<float> &history = sections[section].history;
+    double total = 0.0;
+    for (float ms : history) {
+        total += ms;
+    }
+    return history.empty() ? 0.0 : total / history.size();
+}
+
+double GpuTimer::getMinMs(int section) const {
+    const std::vector<float> &history = sections[section].history;
+    return history.empty() ? 0.0 : *std::min_element(history.begin(), history.end());
+}
+
+double GpuTimer::getPercentileMs(int section, double percentile) const {
+    std::vector<float> sorted = sections[section].history;
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    // Nearest rank
+    size_t rank = (size_t)std::ceil(percentile / 100.0 * sorted.size());
+    size_t index = std::min(std::max(rank, (size_t)1), sorted.size()) - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+void GpuTimer::report(std::ostream &out) const {
+    out << "  " << std::left << std::setw(20) << "pass" << std::right
+        << std::setw(10) << "min" << std::setw(10) << "avg" << std::setw(10) << "p99"
+        << std::setw(10) << "last" << "   (ms)" << std::endl;
+    for (int i = 0; i < getSectionCount(); i++) {
+        out << "  " << std::left << std::setw(20) << sections[i].name << std::right << std::fixed
+            << std::setprecision(3) << std::setw(10) << getMinMs(i) << std::setw(10) << getAverageMs(i)
+            << std::setw(10) << getPercentileMs(i, 99.0) << std::setw(10) << sections[i].lastMs
+            << std::defaultfloat << std::endl;
+    }
+}
+
+void GpuTimer::setCsvOutput(std::ostream *csv) {
+    this->csv = csv;
+    if (csv) {
+        *csv << "frame,pass,ms\n";
+    }
+}
@@ -0,0 +1,131 @@
+#include "InputRecorder.h"
+#include <cstring>
+#include <iostream>
+
+// Bump when the run layout changes
+static const uint32_t INPUT_LOG_VERSION = 1;
+static const uint32_t INPUT_LOG_MAGIC = 0x504E4943; // 'CINP'
+static const size_t INPUT_RUN_BYTES = 13;
+
+bool InputRecorder::open(const std::string &path) {
+    close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open input log: " << path << std::endl;
+        return false;
+    }
+    this->path = path;
+    runStart = runLength = 0;
+    stepCount = runCount = 0;
+    InputLogHeader header = { INPUT_LOG_MAGIC, INPUT_LOG_VERSION, 0, 0 };
+    file.write((const char *)&header, sizeof(header));
+    return true;
+}
+
+void InputRecorder::record(const InputStep &step) {
+    if (!file.is_open()) {
+        return;
+    }
+    // Bit-exact dt compare: replay has to hand back exactly what the simulation got
+    if (runLength > 0 && (step.dt != current.dt || step.keys != current.keys)) {
+        writeRun();
+    }
+    if (runLength == 0) {
+        runStart = (uint32_t)stepCount;
+        current = step;
+    }
+    runLength++;
+    stepCount++;
+}
+
+void InputRecorder::writeRun() {
+    // Packed by hand, the struct would be padded
+    unsigned char bytes[INPUT_RUN_BYTES];
+    uint8_t keys = (uint8_t)current.keys;
+    std::memcpy(bytes, &runStart, 4);
+    std::memcpy(bytes + 4, &runLength, 4);
+    std::memcpy(bytes + 8, &current.dt, 4);
+    std::memcpy(bytes + 12, &keys, 1);
+    file.write((const char *)bytes, sizeof(bytes));
+    runLength = 0;
+    runCount++;
+}
+
+void InputRecorder::close() {
+    if (!file.is_open()) {
+        return;
+    }
+    if (runLength > 0) {
+        writeRun();
+    }
+    InputLogHeader header = { INPUT_LOG_MAGIC, INPUT_LOG_VERSION, stepCount, runCount };
+    file.seekp(0);
+    file.write((const char *)&header, sizeof(header));
+    if (!file.good()) {
+        std::cerr << "Failed to write input log: " << path << std::endl;
+    }
+    file.close();
+}
+
+bool InputPlayer::open(const std::string &path) {
+    opened = false;
+    runs.clear();
+    run = 0;
+    stepInRun = 0;
+    played = 0;
+    std::ifstream file(path, std::ios::binary);
+    InputLogHeader header;
+    if (!file.is_open() || !file.read((char *)&header, sizeof(header))
+        || header.magic != INPUT_LOG_MAGIC || header.version != INPUT_LOG_VERSION) {
+        std::cerr << "Not an input log: " << path << std::endl;
+        return false;
+    }
+    // The run count is only trusted as far as the file has bytes for it
+    std::streamoff runsStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    uint64_t runBytes = (uint64_t)(file.tellg() - runsStart);
+    file.seekg(runsStart);
+    if (!file || header.runCount > runBytes / INPUT_RUN_BYTES) {
+        std::cerr << "Truncated input log: " << path << std::endl;
+        return false;
+    }
+    runs.resize((size_t)header.runCount);
+    uint64_t expectedStep = 0;
+    for (Run &r : runs) {
+        unsigned char bytes[INPUT_RUN_BYTES];
+        if (!file.read((char *)bytes, sizeof(bytes))) {
+            std::cerr << "Truncated input log: " << path << std::endl;
+            runs.clear();
+            return false;
+        }
+        uint8_t keys;
+        std::memcpy(&r.firstStep, bytes, 4);
+        std::memcpy(&r.length, bytes + 4, 4);
+        std::memcpy(&r.step.dt, bytes + 8, 4);
+        std::memcpy(&keys, bytes + 12, 1);
+        r.step.keys = keys;
+        if (r.firstStep != expectedStep) {
+            std::cerr << "Corrupt input log: " << path << std::endl;
+            runs.clear();
+            return false;
+        }
+        expectedStep += r.length;
+    }
+    stepCount = expectedStep;
+    opened = true;
+    return true;
+}
+
+bool InputPlayer::next(InputStep &step) {
+    while (run < runs.size() && stepInRun >= runs[run].length) {
+        run++;
+        stepInRun = 0;
+    }
+    if (run >= runs.size()) {
+        return false;
+    }
+    step = runs[run].step;
+    stepInRun++;
+    played++;
+    return true;
+}
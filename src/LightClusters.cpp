@@ -0,0 +1,201 @@
+#include "LightClusters.h"
+#include <algorithm>
+#include <cmath>
+
+// Reference: Olsson, Billeter, Assarsson, "Clustered Deferred and Forward Shading", HPG 2012
+
+LightClusters::LightClusters(ThreadPool &pool, int tilesX, int tilesY, int slices)
+: pool(pool), tilesX(tilesX), tilesY(tilesY), slices(slices),
+  nearPlane(0.1f), farPlane(100.0f), sliceScale(0.0f), lightCount(0), indexCount(0)
+{
+    clusterGrid.resize((size_t)tilesX * tilesY * slices * 2, 0);
+
+    GLuint buffers[3];
+    glGenBuffers(3, buffers);
+    lightDataBuffer = buffers[0];
+    clusterGridBuffer = buffers[1];
+    lightIndexBuffer = buffers[2];
+
+    GLuint textures[3];
+    glGenTextures(3, textures);
+    lightDataTexture = textures[0];
+    clusterGridTexture = textures[1];
+    lightIndexTexture = textures[2];
+
+    // Allocate something so the textures are complete before the first update
+    auto setup = [](GLuint buffer, GLuint texture, GLenum format) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    };
+    setup(lightDataBuffer, lightDataTexture, GL_RGBA32F);
+    setup(clusterGridBuffer, clusterGridTexture, GL_RG32UI);
+    setup(lightIndexBuffer, lightIndexTexture, GL_R32UI);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightClusters::~LightClusters() {
+    GLuint buffers[3] = { lightDataBuffer, clusterGridBuffer, lightIndexBuffer };
+    GLuint textures[3] = { lightDataTexture, clusterGridTexture, lightIndexTexture };
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+}
+
+int LightClusters::sliceForDepth(float depth) const {
+    // Exponential slicing: slice k covers [near * (far/near)^(k/S), near * (far/near)^((k+1)/S)]
+    int slice = (int)std::floor(std::log(std::max(depth, nearPlane) / nearPlane) * sliceScale);
+    return std::min(std::max(slice, 0), slices - 1);
+}
+
+void LightClusters::update(const std::vector<PointLight> &lights, const glm::mat4 &view, const glm::mat4 &proj,
+                           float nearPlane, float farPlane) {
+    this->nearPlane = nearPlane;
+    this->farPlane = farPlane;
+    sliceScale = slices / std::log(farPlane / nearPlane);
+    lightCount = (int)lights.size();
+
+    int n = lightCount;
+    viewX.resize(n); viewY.resize(n); viewZ.resize(n); radius.resize(n);
+    tileMinX.resize(n); tileMaxX.resize(n); tileMinY.resize(n); tileMaxY.resize(n);
+    sliceMin.resize(n); sliceMax.resize(n);
+    lightData.resize((size_t)std::max(n, 1) * 8);
+
+    float p00 = proj[0][0];
+    float p11 = proj[1][1];
+
+    // Pass 1: per light view-space bounds -> tile and slice ranges
+    pool.parallelFor(n, 256, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const PointLight &light = lights[i];
+            glm::vec4 viewPos = view * glm::vec4(light.position, 1.0f);
+            viewX[i] = viewPos.x;
+            viewY[i] = viewPos.y;
+            viewZ[i] = -viewPos.z; // positive depth in front of the camera
+            radius[i] = light.radius;
+
+            float *data = &lightData[(size_t)i * 8];
+            data[0] = light.position.x; data[1] = light.position.y; data[2] = light.position.z;
+            data[3] = light.radius;
+            data[4] = light.color.x * light.intensity;
+            data[5] = light.color.y * light.intensity;
+            data[6] = light.color.z * light.intensity;
+            data[7] = light.intensity > 0.0f ? light.bakedIntensity / light.intensity : 0.0f;
+        }
+        for (int i = begin; i < end; i++) {
+            float r = radius[i];
+            float dMin = viewZ[i] - r;
+            float dMax = viewZ[i] + r;
+            if (dMax < nearPlane || dMin > farPlane) {
+                sliceMin[i] = 1; sliceMax[i] = 0; // empty range, never binned
+                continue;
+            }
+            dMin = std::max(dMin, nearPlane);
+            dMax = std::min(dMax, farPlane);
+
+            // Conservative screen bounds of the sphere's view-space box: x/d is extreme at the box corners
+            float xl = viewX[i] - r, xh = viewX[i] + r;
+            float yl = viewY[i] - r, yh = viewY[i] + r;
+            float ndcMinX = p00 * std::min(xl / dMin, xl / dMax);
+            float ndcMaxX = p00 * std::max(xh / dMin, xh / dMax);
+            float ndcMinY = p11 * std::min(yl / dMin, yl / dMax);
+            float ndcMaxY = p11 * std::max(yh / dMin, yh / dMax);
+            if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f) {
+                sliceMin[i] = 1; sliceMax[i] = 0;
+                continue;
+            }
+
+            tileMinX[i] = std::max(0, (int)std::floor((ndcMinX * 0.5f + 0.5f) * tilesX));
+            tileMaxX[i] = std::min(tilesX - 1, (int)std::floor((ndcMaxX * 0.5f + 0.5f) * tilesX));
+            tileMinY[i] = std::max(0, (int)std::floor((ndcMinY * 0.5f + 0.5f) * tilesY));
+            tileMaxY[i] = std::min(tilesY - 1, (int)std::floor((ndcMaxY * 0.5f + 0.5f) * tilesY));
+            sliceMin[i] = sliceForDepth(dMin);
+            sliceMax[i] = sliceForDepth(dMax);
+        }
+    });
+
+    // Pass 2: count lights per cluster. Each job owns whole depth slices, so no two threads
+    // ever touch the same cluster.
+    int clustersPerSlice = tilesX * tilesY;
+    auto forEachCluster = [&](int slice, int light, auto &&fn) {
+        if (slice < sliceMin[light] || slice > sliceMax[light]) {
+            return;
+        }
+        for (int ty = tileMinY[light]; ty <= tileMaxY[light]; ty++) {
+            int row = slice * clustersPerSlice + ty * tilesX;
+            for (int tx = tileMinX[light]; tx <= tileMaxX[light]; tx++) {
+                fn(row + tx);
+            }
+        }
+    };
+
+    pool.parallelFor(slices, 1, [&](int begin, int end) {
+        for (int s = begin; s < end; s++) {
+            uint32_t *grid = &clusterGrid[(size_t)s * clustersPerSlice * 2];
+            for (int c = 0; c < clustersPerSlice; c++) {
+                grid[c*2 + 1] = 0;
+            }
+            for (int i = 0; i < n; i++) {
+                forEachCluster(s, i, [&](int cluster) { clusterGrid[cluster*2 + 1]++; });
+            }
+        }
+    });
+
+    // Prefix sum into offsets
+    uint32_t total = 0;
+    int clusterCount = getClusterCount();
+    for (int c = 0; c < clusterCount; c++) {
+        clusterGrid[c*2] = total;
+        total += clusterGrid[c*2 + 1];
+    }
+    indexCount = (int)total;
+    if (lightIndices.size() < (size_t)total + 4) {
+        lightIndices.resize((size_t)total + 4); // slack keeps the minimum upload size in bounds
+    }
+
+    // Pass 3: write the light indices
+    pool.parallelFor(slices, 1, [&](int begin, int end) {
+        std::vector<uint32_t> cursor(clustersPerSlice);
+        for (int s = begin; s < end; s++) {
+            for (int c = 0; c < clustersPerSlice; c++) {
+                cursor[c] = clusterGrid[((size_t)s * clustersPerSlice + c) * 2];
+            }
+            for (int i = 0; i < n; i++) {
+                forEachCluster(s, i, [&](int cluster) {
+                    lightIndices[cursor[cluster - s * clustersPerSlice]++] = (uint32_t)i;
+                });
+            }
+        }
+    });
+
+    // Upload, orphaning the old storage so we never wait on last frame's draws
+    auto upload = [](GLuint buffer, const void *data, size_t bytes) {
+        bytes = std::max<size_t>(bytes, 16);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+    };
+    upload(lightDataBuffer, lightData.data(), (size_t)n * 8 * sizeof(float));
+    upload(clusterGridBuffer, clusterGrid.data(), clusterGrid.size() * sizeof(uint32_t));
+    upload(lightIndexBuffer, lightIndices.data(), (size_t)indexCount * sizeof(uint32_t));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::bind(const Shader &shader, int firstUnit, const glm::vec2 &screenSize) const {
+    glActiveTexture(GL_TEXTURE0 + firstUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lightDataTexture);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+    glBindTexture(GL_TEXTURE_BUFFER, clusterGridTexture);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+    glBindTexture(GL_TEXTURE_BUFFER, lightIndexTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setInt("uLightData", firstUnit);
+    shader.setInt("uClusterGrid", firstUnit + 1);
+    shader.setInt("uLightIndices", firstUnit + 2);
+    shader.setIVec3("uClusterDims", tilesX, tilesY, slices);
+    shader.setFloat("uClusterNear", nearPlane);
+    shader.setFloat("uClusterFar", farPlane);
+    shader.setVec2("uScreenSize", screenSize);
+}
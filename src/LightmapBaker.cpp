@@ -0,0 +1,246 @@
+#include "LightmapBaker.h"
+#include "MeshFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LIGHTMAP_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// Bump when the baking model changes, it invalidates cached lightmaps
+static const uint32_t LIGHTMAP_VERSION = 1;
+static const uint32_t LIGHTMAP_FILE_MAGIC = 0x504D4C43; // 'CLMP'
+static const int LIGHTMAP_TILE = 16;
+static const float RAY_EPSILON = 1e-3f;
+
+struct LightmapFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t width;
+    uint32_t height;
+};
+
+int lightmapWidth(const LightmapSettings &settings) {
+    return settings.faceResolution * LIGHTMAP_COLUMNS;
+}
+
+int lightmapHeight(int faceCount, const LightmapSettings &settings) {
+    return settings.faceResolution * ((faceCount + LIGHTMAP_COLUMNS - 1) / LIGHTMAP_COLUMNS);
+}
+
+glm::vec2 lightmapCoord(int face, int faceCount, float u, float v, const LightmapSettings &settings) {
+    // Face corners land on the first and last texel centers of the tile
+    float r = (float)settings.faceResolution;
+    float x = (face % LIGHTMAP_COLUMNS) * r + 0.5f + u * (r - 1.0f);
+    float y = (face / LIGHTMAP_COLUMNS) * r + 0.5f + v * (r - 1.0f);
+    return glm::vec2(x / lightmapWidth(settings), y / lightmapHeight(faceCount, settings));
+}
+
+// Occluders in groups of four, one SIMD register per slab plane
+struct BoxPacket {
+    alignas(16) float minX[4], minY[4], minZ[4];
+    alignas(16) float maxX[4], maxY[4], maxZ[4];
+};
+
+static std::vector<BoxPacket> PackBoxes(const std::vector<LightmapBox> &boxes) {
+    std::vector<BoxPacket> packets((boxes.size() + 3) / 4);
+    for (size_t p = 0; p < packets.size(); p++) {
+        BoxPacket &packet = packets[p];
+        for (int lane = 0; lane < 4; lane++) {
+            size_t i = p * 4 + lane;
+            // Unused lanes get a point box far outside the scene, so they never hit
+            LightmapBox box = i < boxes.size() ? boxes[i] : LightmapBox{glm::vec3(1e30f), glm::vec3(1e30f)};
+            packet.minX[lane] = box.min.x; packet.minY[lane] = box.min.y; packet.minZ[lane] = box.min.z;
+            packet.maxX[lane] = box.max.x; packet.maxY[lane] = box.max.y; packet.maxZ[lane] = box.max.z;
+        }
+    }
+    return packets;
+}
+
+static glm::vec3 SafeInverse(const glm::vec3 &d) {
+    auto inv = [](float x) { return 1.0f / (std::fabs(x) < 1e-12f ? std::copysign(1e-12f, x) : x); };
+    return glm::vec3(inv(d.x), inv(d.y), inv(d.z));
+}
+
+// Does the segment origin + t * dir, t in (RAY_EPSILON, tMax), hit any box? Slab test, 4 boxes at a time.
+static bool SegmentBlocked(const std::vector<BoxPacket> &packets, const glm::vec3 &origin,
+                           const glm::vec3 &invDir, float tMax) {
+#ifdef LIGHTMAP_SSE
+    const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+    const __m128 ix = _mm_set1_ps(invDir.x), iy = _mm_set1_ps(invDir.y), iz = _mm_set1_ps(invDir.z);
+    const __m128 tMin4 = _mm_set1_ps(RAY_EPSILON), tMax4 = _mm_set1_ps(tMax);
+    for (const BoxPacket &p : packets) {
+        __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p.minX), ox), ix);
+        __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p.maxX), ox), ix);
+        __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p.minY), oy), iy);
+        __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p.maxY), oy), iy);
+        __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p.minZ), oz), iz);
+        __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p.maxZ), oz), iz);
+        __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)),
+                                  _mm_max_ps(_mm_min_ps(t0z, t1z), tMin4));
+        __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)),
+                                 _mm_min_ps(_mm_max_ps(t0z, t1z), tMax4));
+        if (_mm_movemask_ps(_mm_cmple_ps(enter, exit))) {
+            return true;
+        }
+    }
+    return false;
+#else
+    for (const BoxPacket &p : packets) {
+        for (int lane = 0; lane < 4; lane++) {
+            float t0x = (p.minX[lane] - origin.x) * invDir.x, t1x = (p.maxX[lane] - origin.x) * invDir.x;
+            float t0y = (p.minY[lane] - origin.y) * invDir.y, t1y = (p.maxY[lane] - origin.y) * invDir.y;
+            float t0z = (p.minZ[lane] - origin.z) * invDir.z, t1z = (p.maxZ[lane] - origin.z) * invDir.z;
+            float enter = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)),
+                                   std::max(std::min(t0z, t1z), RAY_EPSILON));
+            float exit = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)),
+                                  std::min(std::max(t0z, t1z), tMax));
+            if (enter <= exit) {
+                return true;
+            }
+        }
+    }
+    return false;
+#endif
+}
+
+// Same falloff as lightAttenuation() in shaders/clustered_lights.glsl
+static float LightAttenuation(float dist, float radius) {
+    float falloff = 1.0f / (1.0f + 0.09f * dist + 0.032f * (dist * dist));
+    float ratio = dist / radius;
+    float window = std::min(std::max(1.0f - ratio * ratio * ratio * ratio, 0.0f), 1.0f);
+    return falloff * window * window;
+}
+
+// Diffuse irradiance from all lights at a surface point, with shadow rays
+static glm::vec3 DirectIrradiance(const glm::vec3 &position, const glm::vec3 &normal,
+                                  const std::vector<PointLight> &lights, const std::vector<BoxPacket> &packets) {
+    glm::vec3 result(0.0f);
+    for (const PointLight &light : lights) {
+        glm::vec3 toLight = light.position - position;
+        float dist = glm::length(toLight);
+        if (dist >= light.radius || dist < 1e-6f) {
+            continue;
+        }
+        glm::vec3 dir = toLight / dist;
+        float cosine = glm::dot(normal, dir);
+        if (cosine <= 0.0f) {
+            continue;
+        }
+        if (SegmentBlocked(packets, position, SafeInverse(dir), dist)) {
+            continue;
+        }
+        result += light.color * (light.intensity * cosine * LightAttenuation(dist, light.radius));
+    }
+    return result;
+}
+
+static float NextRandom(uint32_t &state) {
+    // xorshift32, seeded per texel so the bake is deterministic whatever the thread count
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+std::vector<float> bakeLightmap(ThreadPool &pool, const std::vector<LightmapFace> &faces,
+                                const std::vector<PointLight> &lights, const std::vector<LightmapBox> &occluders,
+                                const LightmapSettings &settings) {
+    int width = lightmapWidth(settings);
+    int height = lightmapHeight((int)faces.size(), settings);
+    int resolution = settings.faceResolution;
+    std::vector<float> texels((size_t)width * height * 3, 0.0f);
+    std::vector<BoxPacket> packets = PackBoxes(occluders);
+
+    int tilesX = (width + LIGHTMAP_TILE - 1) / LIGHTMAP_TILE;
+    int tilesY = (height + LIGHTMAP_TILE - 1) / LIGHTMAP_TILE;
+
+    pool.parallelFor(tilesX * tilesY, 1, [&](int begin, int end) {
+        for (int tile = begin; tile < end; tile++) {
+            int x0 = (tile % tilesX) * LIGHTMAP_TILE;
+            int y0 = (tile / tilesX) * LIGHTMAP_TILE;
+            for (int y = y0; y < std::min(y0 + LIGHTMAP_TILE, height); y++) {
+                for (int x = x0; x < std::min(x0 + LIGHTMAP_TILE, width); x++) {
+                    int faceIndex = (y / resolution) * LIGHTMAP_COLUMNS + x / resolution;
+                    if (faceIndex >= (int)faces.size()) {
+                        continue;
+                    }
+                    const LightmapFace &face = faces[faceIndex];
+                    float u = (x % resolution) / (float)(resolution - 1);
+                    float v = (y % resolution) / (float)(resolution - 1);
+                    glm::vec3 position = face.origin + face.edgeU * u + face.edgeV * v + face.normal * RAY_EPSILON;
+
+                    glm::vec3 irradiance = DirectIrradiance(position, face.normal, lights, packets);
+
+                    // One bounce: cosine weighted rays to the enclosing box, Lambertian reflection there
+                    glm::vec3 tangent = glm::normalize(face.edgeU);
+                    glm::vec3 bitangent = glm::cross(face.normal, tangent);
+                    uint32_t state = (uint32_t)(x * 1973 + y * 9277 + 1) * 26699u | 1u;
+                    glm::vec3 indirect(0.0f);
+                    for (int s = 0; s < settings.bounceSamples; s++) {
+                        float r1 = NextRandom(state), r2 = NextRandom(state);
+                        float r = std::sqrt(r1), phi = 6.2831853f * r2;
+                        glm::vec3 dir = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi))
+                                      + face.normal * std::sqrt(std::max(0.0f, 1.0f - r1));
+
+                        // Exit point of the ray from the inside of the box
+                        float tWall = 1e30f;
+                        int axis = 0;
+                        for (int a = 0; a < 3; a++) {
+                            if (std::fabs(dir[a]) < 1e-8f) continue;
+                            float t = ((dir[a] > 0.0f ? settings.boundsMax[a] : settings.boundsMin[a]) - position[a]) / dir[a];
+                            if (t < tWall) {
+                                tWall = t;
+                                axis = a;
+                            }
+                        }
+                        if (tWall >= 1e30f || SegmentBlocked(packets, position, SafeInverse(dir), tWall)) {
+                            continue; // hit an occluder, its bounce is small enough to drop
+                        }
+                        glm::vec3 hitNormal(0.0f);
+                        hitNormal[axis] = dir[axis] > 0.0f ? -1.0f : 1.0f;
+                        glm::vec3 hit = position + dir * tWall + hitNormal * RAY_EPSILON;
+                        indirect += DirectIrradiance(hit, hitNormal, lights, packets);
+                    }
+                    if (settings.bounceSamples > 0) {
+                        irradiance += settings.bounceAlbedo * indirect / (float)settings.bounceSamples;
+                    }
+
+                    float *texel = &texels[((size_t)y * width + x) * 3];
+                    texel[0] = irradiance.x;
+                    texel[1] = irradiance.y;
+                    texel[2] = irradiance.z;
+                }
+            }
+        }
+    });
+    return texels;
+}
+
+uint64_t lightmapKey(const std::vector<LightmapFace> &faces, const std::vector<PointLight> &lights,
+                     const std::vector<LightmapBox> &occluders, const LightmapSettings &settings) {
+    uint64_t key = hashBytes(&LIGHTMAP_VERSION, sizeof(LIGHTMAP_VERSION));
+    key = hashBytes(faces.data(), faces.size() * sizeof(LightmapFace), key);
+    for (const PointLight &light : lights) {
+        float values[8] = { light.position.x, light.position.y, light.position.z, light.radius,
+                            light.color.x, light.color.y, light.color.z, light.intensity };
+        key = hashBytes(values, sizeof(values), key);
+    }
+    key = hashBytes(occluders.data(), occluders.size() * sizeof(LightmapBox), key);
+    key = hashBytes(&settings, sizeof(settings), key);
+    return key;
+}
+
+bool readLightmapFile(const std::string &path, uint64_t key, int width, int height, std::vector<float> &texels) {
+    LightmapFileHeader header = { LIGHTMAP_FILE_MAGIC, LIGHTMAP_VERSION, key, (uint32_t)width, (uint32_t)height };
+    texels.resize((size_t)width * height * 3);
+    return readCacheFile(path, &header, sizeof(header), texels.data(), texels.size() * sizeof(float));
+}
+
+bool writeLightmapFile(const std::string &path, uint64_t key, int width, int height, const std::vector<float> &texels) {
+    LightmapFileHeader header = { LIGHTMAP_FILE_MAGIC, LIGHTMAP_VERSION, key, (uint32_t)width, (uint32_t)height };
+    return writeCacheFile(path, &header, sizeof(header), texels.data(), texels.size() * sizeof(float));
+}
@@ -0,0 +1,252 @@
+#include "MeshFile.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char *MESH_CACHE_DIR = "cache";
+
+MeshFile::MeshFile() : base(nullptr), size(0), header(nullptr)
+#ifdef _WIN32
+, fileHandle(nullptr), mappingHandle(nullptr)
+#endif
+{}
+
+MeshFile::~MeshFile() {
+    close();
+}
+
+bool MeshFile::open(const std::string &path, uint64_t expectedKey) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(MeshFileHeader)) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    base = (const unsigned char *)view;
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MeshFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    base = (const unsigned char *)view;
+    size = (size_t)st.st_size;
+#endif
+
+    // Validate everything up front so the accessors never read out of bounds
+    header = (const MeshFileHeader *)base;
+    size_t tableEnd = sizeof(MeshFileHeader)
+                    + (size_t)header->attributeCount * sizeof(MeshFileAttribute)
+                    + (size_t)header->rangeCount * sizeof(MeshFileRange);
+    bool valid = header->magic == MESH_FILE_MAGIC
+              && header->version == MESH_FILE_VERSION
+              && (header->indexSize == 2 || header->indexSize == 4)
+              && tableEnd <= size
+              && header->vertexDataOffset >= tableEnd
+              && (size_t)header->vertexDataOffset + vertexDataSize() <= size
+              && (size_t)header->indexDataOffset + indexDataSize() <= size;
+    if (!valid) {
+        std::cerr << "Invalid mesh file: " << path << std::endl;
+        close();
+        return false;
+    }
+    if (expectedKey != 0 && header->key != expectedKey) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MeshFile::close() {
+    if (!base) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle((HANDLE)mappingHandle);
+    CloseHandle((HANDLE)fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap((void *)base, size);
+#endif
+    base = nullptr;
+    size = 0;
+    header = nullptr;
+}
+
+VertexLayout MeshFile::getLayout() const {
+    VertexLayout layout;
+    layout.stride = header->vertexStride;
+    const MeshFileAttribute *attributes = (const MeshFileAttribute *)(base + sizeof(MeshFileHeader));
+    for (uint32_t i = 0; i < header->attributeCount; i++) {
+        layout.attributes.push_back({attributes[i].location, attributes[i].components, attributes[i].offset});
+    }
+    return layout;
+}
+
+std::vector<MeshFileRange> MeshFile::getRanges() const {
+    const MeshFileRange *ranges = (const MeshFileRange *)(base + sizeof(MeshFileHeader)
+                                  + header->attributeCount * sizeof(MeshFileAttribute));
+    return std::vector<MeshFileRange>(ranges, ranges + header->rangeCount);
+}
+
+bool writeMeshFile(const std::string &path, uint64_t key, const VertexLayout &layout,
+                   const MeshData &mesh, unsigned int indexSize,
+                   const std::vector<MeshFileRange> &ranges) {
+    MeshFileHeader header = {};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.key = key;
+    header.vertexCount = (uint32_t)mesh.vertexCount();
+    header.vertexStride = layout.stride;
+    header.indexCount = (uint32_t)mesh.indices.size();
+    header.indexSize = indexSize;
+    header.attributeCount = (uint32_t)layout.attributes.size();
+    header.rangeCount = (uint32_t)ranges.size();
+    header.vertexDataOffset = (uint32_t)(sizeof(MeshFileHeader)
+                            + layout.attributes.size() * sizeof(MeshFileAttribute)
+                            + ranges.size() * sizeof(MeshFileRange));
+    header.indexDataOffset = header.vertexDataOffset + (uint32_t)(mesh.vertices.size() * sizeof(float));
+
+    // Write to a temporary name and rename, so a crash never leaves a truncated cache entry behind
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write mesh file: " << path << std::endl;
+            return false;
+        }
+        file.write((const char *)&header, sizeof(header));
+        for (const VertexAttribute &a : layout.attributes) {
+            MeshFileAttribute attribute = {a.location, a.components, a.offset, 0};
+            file.write((const char *)&attribute, sizeof(attribute));
+        }
+        file.write((const char *)ranges.data(), ranges.size() * sizeof(MeshFileRange));
+        file.write((const char *)mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+        if (indexSize == 2) {
+            std::vector<uint16_t> shortIndices(mesh.indices.begin(), mesh.indices.end());
+            file.write((const char *)shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+        } else {
+            file.write((const char *)mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+        }
+        if (!file.good()) {
+            std::cerr << "Failed to write mesh file: " << path << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::cerr << "Failed to write mesh file: " << path << " (" << error.message() << ")" << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::string meshCachePath(const std::string &name, uint64_t key) {
+    return cacheFilePath(name, key, "mesh");
+}
+
+std::string cacheFilePath(const std::string &name, uint64_t key, const std::string &extension) {
+    std::error_code error;
+    std::filesystem::create_directories(MESH_CACHE_DIR, error);
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+    return std::string(MESH_CACHE_DIR) + "/" + name + "_" + hex + "." + extension;
+}
+
+bool readCacheFile(const std::string &path, const void *header, size_t headerSize, void *blob, size_t blobSize) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<char> stored(headerSize);
+    if (!file.read(stored.data(), headerSize) || std::memcmp(stored.data(), header, headerSize) != 0) {
+        return false;
+    }
+    if (!file.read((char *)blob, blobSize)) {
+        std::cerr << "Truncated cache file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool writeCacheFile(const std::string &path, const void *header, size_t headerSize, const void *blob, size_t blobSize) {
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write((const char *)header, headerSize);
+        file.write((const char *)blob, blobSize);
+        if (!file.good()) {
+            std::cerr << "Failed to write cache file: " << path << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::cerr << "Failed to write cache file: " << path << " (" << error.message() << ")" << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
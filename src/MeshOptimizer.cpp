@@ -0,0 +1,302 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+// References:
+// - Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Tipsify), SIGGRAPH 2007
+// - Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006 (same goal, we use Tipsify since it is linear and simpler)
+
+void weldVertices(MeshData &mesh, float epsilon) {
+    int stride = mesh.floatsPerVertex;
+    int vertexCount = mesh.vertexCount();
+    if (vertexCount == 0) {
+        return;
+    }
+
+    // Quantize every attribute onto an epsilon grid so equal vertices hash the same
+    std::vector<int32_t> keys(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        keys[i] = (int32_t)std::lround(mesh.vertices[i] / epsilon);
+    }
+
+    auto hashVertex = [&](int v) {
+        uint64_t h = 14695981039346656037ull; // FNV-1a
+        for (int c = 0; c < stride; c++) {
+            h ^= (uint32_t)keys[v*stride + c];
+            h *= 1099511628211ull;
+        }
+        return h;
+    };
+    auto sameVertex = [&](int a, int b) {
+        return std::equal(keys.begin() + a*stride, keys.begin() + (a+1)*stride, keys.begin() + b*stride);
+    };
+
+    std::unordered_multimap<uint64_t, int> seen;
+    seen.reserve(vertexCount);
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<float> welded;
+    welded.reserve(mesh.vertices.size());
+    int weldedCount = 0;
+
+    for (int v = 0; v < vertexCount; v++) {
+        uint64_t h = hashVertex(v);
+        int match = -1;
+        auto range = seen.equal_range(h);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (sameVertex(it->second, v)) {
+                match = it->second;
+                break;
+            }
+        }
+        if (match >= 0) {
+            remap[v] = remap[match];
+        } else {
+            seen.emplace(h, v);
+            remap[v] = weldedCount++;
+            welded.insert(welded.end(), mesh.vertices.begin() + v*stride, mesh.vertices.begin() + (v+1)*stride);
+        }
+    }
+
+    // Rewrite indices, dropping triangles that collapsed onto an edge or a point
+    std::vector<unsigned int> indices;
+    indices.reserve(mesh.indices.size());
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        unsigned int a = remap[mesh.indices[t]];
+        unsigned int b = remap[mesh.indices[t+1]];
+        unsigned int c = remap[mesh.indices[t+2]];
+        if (a != b && b != c && a != c) {
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(c);
+        }
+    }
+
+    mesh.vertices.swap(welded);
+    mesh.indices.swap(indices);
+}
+
+void optimizeVertexCache(MeshData &mesh, int cacheSize) {
+    int vertexCount = mesh.vertexCount();
+    int triangleCount = (int)(mesh.indices.size() / 3);
+    if (triangleCount == 0) {
+        return;
+    }
+    const std::vector<unsigned int> &in = mesh.indices;
+
+    // Vertex -> triangle adjacency in compressed form
+    std::vector<int> adjOffset(vertexCount + 1, 0);
+    for (unsigned int idx : in) {
+        adjOffset[idx + 1]++;
+    }
+    for (int v = 0; v < vertexCount; v++) {
+        adjOffset[v + 1] += adjOffset[v];
+    }
+    std::vector<int> adjacency(in.size());
+    std::vector<int> fill(adjOffset.begin(), adjOffset.end() - 1);
+    for (int t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            adjacency[fill[in[t*3 + k]]++] = t;
+        }
+    }
+
+    std::vector<int> liveTriangles(vertexCount);
+    for (int v = 0; v < vertexCount; v++) {
+        liveTriangles[v] = adjOffset[v + 1] - adjOffset[v];
+    }
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<int> deadEnd;
+    std::vector<int> candidates;
+    std::vector<unsigned int> out;
+    out.reserve(in.size());
+
+    int time = cacheSize + 1;
+    int cursor = 0;
+    int fanning = in[0];
+
+    // When the fan runs dry: try recently used vertices first, then scan forward
+    auto skipDeadEnd = [&]() {
+        while (!deadEnd.empty()) {
+            int d = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[d] > 0) {
+                return d;
+            }
+        }
+        while (cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0) {
+                return cursor;
+            }
+            cursor++;
+        }
+        return -1;
+    };
+
+    while (fanning >= 0) {
+        candidates.clear();
+        for (int a = adjOffset[fanning]; a < adjOffset[fanning + 1]; a++) {
+            int t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                int v = in[t*3 + k];
+                out.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                }
+            }
+            emitted[t] = 1;
+        }
+
+        // Next fanning vertex: the one that will still be in cache after its remaining triangles
+        int best = -1;
+        int bestPriority = -1;
+        for (int v : candidates) {
+            if (liveTriangles[v] > 0) {
+                int priority = 0;
+                if (time - cacheTime[v] + 2*liveTriangles[v] <= cacheSize) {
+                    priority = time - cacheTime[v];
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    best = v;
+                }
+            }
+        }
+        fanning = best >= 0 ? best : skipDeadEnd();
+    }
+
+    mesh.indices.swap(out);
+}
+
+void optimizeOverdraw(MeshData &mesh, float threshold, int cacheSize) {
+    int vertexCount = mesh.vertexCount();
+    int triangleCount = (int)(mesh.indices.size() / 3);
+    if (triangleCount < 2) {
+        return;
+    }
+    const std::vector<unsigned int> &in = mesh.indices;
+    int stride = mesh.floatsPerVertex;
+    auto position = [&](unsigned int v) {
+        return glm::vec3(mesh.vertices[v*stride], mesh.vertices[v*stride + 1], mesh.vertices[v*stride + 2]);
+    };
+
+    // Split the current order into clusters at "hard" boundaries: triangles where all three
+    // vertices miss the cache. Moving whole clusters around barely changes ACMR.
+    std::vector<int> clusterStart;
+    std::vector<int> fifo(vertexCount, -1);
+    int time = 0;
+    for (int t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = in[t*3 + k];
+            if (fifo[v] < 0 || time - fifo[v] >= cacheSize) {
+                fifo[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            clusterStart.push_back(t);
+        }
+    }
+    clusterStart.push_back(triangleCount);
+    int clusterCount = (int)clusterStart.size() - 1;
+    if (clusterCount < 2) {
+        return;
+    }
+
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> clusterCenter(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+    for (int c = 0; c < clusterCount; c++) {
+        float area = 0.0f;
+        for (int t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+            glm::vec3 p0 = position(in[t*3]);
+            glm::vec3 p1 = position(in[t*3 + 1]);
+            glm::vec3 p2 = position(in[t*3 + 2]);
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float a = glm::length(n);
+            clusterCenter[c] += (p0 + p1 + p2) * (a / 3.0f);
+            clusterNormal[c] += n;
+            area += a;
+        }
+        meshCenter += clusterCenter[c];
+        meshArea += area;
+        if (area > 0.0f) {
+            clusterCenter[c] /= area;
+        }
+    }
+    if (meshArea > 0.0f) {
+        meshCenter /= meshArea;
+    }
+
+    // Occlusion potential: clusters far out along their own normal tend to hide the rest
+    std::vector<float> sortKey(clusterCount);
+    std::vector<int> order(clusterCount);
+    for (int c = 0; c < clusterCount; c++) {
+        float len = glm::length(clusterNormal[c]);
+        glm::vec3 n = len > 0.0f ? clusterNormal[c] / len : glm::vec3(0.0f);
+        sortKey[c] = glm::dot(clusterCenter[c] - meshCenter, n);
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<unsigned int> out;
+    out.reserve(in.size());
+    for (int c : order) {
+        out.insert(out.end(), in.begin() + clusterStart[c]*3, in.begin() + clusterStart[c + 1]*3);
+    }
+
+    if (computeACMR(out, vertexCount, cacheSize) <= computeACMR(in, vertexCount, cacheSize) * threshold) {
+        mesh.indices.swap(out);
+    }
+}
+
+void optimizeVertexFetch(MeshData &mesh) {
+    int stride = mesh.floatsPerVertex;
+    int vertexCount = mesh.vertexCount();
+    std::vector<int> remap(vertexCount, -1);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    int next = 0;
+
+    for (unsigned int &idx : mesh.indices) {
+        if (remap[idx] < 0) {
+            remap[idx] = next++;
+            vertices.insert(vertices.end(), mesh.vertices.begin() + idx*stride, mesh.vertices.begin() + (idx+1)*stride);
+        }
+        idx = (unsigned int)remap[idx];
+    }
+
+    mesh.vertices.swap(vertices);
+}
+
+void optimizeMesh(MeshData &mesh) {
+    weldVertices(mesh);
+    optimizeVertexCache(mesh);
+    optimizeOverdraw(mesh);
+    optimizeVertexFetch(mesh);
+}
+
+float computeACMR(const std::vector<unsigned int> &indices, int vertexCount, int cacheSize) {
+    if (indices.size() < 3) {
+        return 0.0f;
+    }
+    // FIFO cache: a vertex is resident if it was pushed less than cacheSize pushes ago
+    std::vector<int> pushedAt(vertexCount, -1);
+    int pushes = 0;
+    for (unsigned int v : indices) {
+        if (pushedAt[v] < 0 || pushes - pushedAt[v] >= cacheSize) {
+            pushedAt[v] = pushes++;
+        }
+    }
+    return (float)pushes / (float)(indices.size() / 3);
+}
@@ -0,0 +1,136 @@
+#include "ParticleCompositor.h"
+#include <algorithm>
+#include <iostream>
+
+ParticleCompositor::ParticleCompositor(int width, int height, int downscale)
+: width(width), height(height), downscale(std::max(1, downscale)), lowWidth(0), lowHeight(0),
+  FBO(0), colorTexture(0), depthTexture(0), emptyVAO(0),
+  depthDownsampleShader("shaders/fullscreen.vert", "shaders/depth_downsample.frag"),
+  compositeShader("shaders/fullscreen.vert", "shaders/particle_composite.frag")
+{
+    glGenVertexArrays(1, &emptyVAO);
+    createTargets();
+}
+
+ParticleCompositor::~ParticleCompositor() {
+    destroyTargets();
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void ParticleCompositor::createTargets() {
+    lowWidth = std::max(1, (width + downscale - 1) / downscale);
+    lowHeight = std::max(1, (height + downscale - 1) / downscale);
+
+    // Both are read with texelFetch in the composite, nearest is all we need
+    auto makeTexture = [&](GLint internalFormat, GLenum format, GLenum type) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, lowWidth, lowHeight, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    };
+    colorTexture = makeTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+    depthTexture = makeTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Particle framebuffer is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ParticleCompositor::destroyTargets() {
+    GLuint textures[2] = { colorTexture, depthTexture };
+    glDeleteTextures(2, textures);
+    glDeleteFramebuffers(1, &FBO);
+}
+
+void ParticleCompositor::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    destroyTargets();
+    createTargets();
+}
+
+void ParticleCompositor::begin(GLuint sceneDepthTexture) {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, lowWidth, lowHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Depth downsample: every low-res pixel takes the farthest depth of its block, so a
+    // particle is never hidden by geometry covering only part of the block. The bilateral
+    // composite sorts out the edges.
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_BLEND);
+    glDepthFunc(GL_ALWAYS);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    depthDownsampleShader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, sceneDepthTexture);
+    depthDownsampleShader.setInt("uDepth", 0);
+    depthDownsampleShader.setInt("uScale", downscale);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthFunc(GL_LESS);
+    if (blend) glEnable(GL_BLEND);
+
+    // Additive sprites need no depth writes, only the test against the scene
+    glDepthMask(GL_FALSE);
+}
+
+void ParticleCompositor::composite(GLuint sceneColorFramebuffer, GLuint sceneDepthTexture,
+                                   float nearPlane, float farPlane, bool premultiplied) {
+    glDepthMask(GL_TRUE);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneColorFramebuffer);
+    glViewport(0, 0, width, height);
+
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLint blendSrc, blendDst;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDst);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    if (premultiplied) {
+        glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
+    } else {
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE);
+    }
+
+    compositeShader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, sceneDepthTexture);
+    glActiveTexture(GL_TEXTURE0);
+    compositeShader.setInt("uParticles", 0);
+    compositeShader.setInt("uLowDepth", 1);
+    compositeShader.setInt("uSceneDepth", 2);
+    compositeShader.setInt("uScale", downscale);
+    compositeShader.setFloat("uNear", nearPlane);
+    compositeShader.setFloat("uFar", farPlane);
+
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glBlendFunc(blendSrc, blendDst);
+    if (!blend) glDisable(GL_BLEND);
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+}
@@ -1,35 +1,89 @@
 #include "ParticleEmitter.h"
-#include <glm/gtc/random.hpp>
+#include "CurlNoise.h"
+#include "Profiler.h"
 #include <algorithm>
-#include <random>
 
 //Refrences for Particle Emitter: https://learnopengl.com/In-Practice/2D-Game/Particles
 
-ParticleEmitter::ParticleEmitter(int maxParticles, EmitterType type)
-: maxParticles(maxParticles), emitterType(type)
+static const int TURBULENCE_BATCH = 64;
+static const float TURBULENCE_SCROLL = 0.25f; // field tiles per second, the swirls drift down through the flame
+
+ParticleEmitter::ParticleEmitter(BufferArena &arena, int maxParticles, EmitterType type)
+: maxParticles(maxParticles), particleLimit(maxParticles), liveCount(0), arena(arena), emitterType(type),
+  lifeSpan(type == EmitterType::CoreFlame ? 0.7f : 1.5f),
+  turbulence(nullptr), turbulenceStrength(0.0f), turbulenceScale(1.0f), time(0.0f), rng(1)
 {
     particles.resize(maxParticles);
 
-    glGenVertexArrays(1,&VAO);
-    glBindVertexArray(VAO);
+    // Every emitter gets its own range of the arena's shared dynamic buffer
+    stream = arena.allocateStream(vertexLayout(), maxParticles);
+
+    for (auto &p : particles) {
+        p.life = -1.0f;
+    }
+
+    emissionPosition = glm::vec3(0.0f);
+}
 
-    glGenBuffers(1,&VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, maxParticles*3*sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+ParticleEmitter::~ParticleEmitter() {
+    arena.freeStream(stream);
+}
 
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,(void*)0);
-    glEnableVertexAttribArray(0);
+VertexLayout ParticleEmitter::vertexLayout() {
+    VertexLayout layout;
+    layout.stride = 3*sizeof(float);
+    layout.attributes = { {0, 3, 0} };
+    return layout;
+}
 
-    glBindVertexArray(0);
+void ParticleEmitter::setTurbulence(const CurlNoiseField *field, float strength, float scale) {
+    turbulence = field;
+    turbulenceStrength = strength;
+    turbulenceScale = scale;
+}
 
+void ParticleEmitter::clear() {
     for (auto &p : particles) {
         p.life = -1.0f;
     }
+    liveCount = 0;
+}
 
-    emissionPosition = glm::vec3(0.0f);
+void ParticleEmitter::setParticleLimit(int limit) {
+    particleLimit = std::min(std::max(limit, 0), maxParticles);
+    if (liveCount <= particleLimit) {
+        return;
+    }
+    std::vector<int> live;
+    live.reserve(liveCount);
+    for (int i = 0; i < maxParticles; i++) {
+        if (particles[i].life > 0.0f) {
+            live.push_back(i);
+        }
+    }
+    int excess = (int)live.size() - particleLimit;
+    std::nth_element(live.begin(), live.begin() + excess, live.end(),
+                     [&](int a, int b) { return particles[a].life < particles[b].life; });
+    for (int i = 0; i < excess; i++) {
+        particles[live[i]].life = -1.0f;
+    }
+    liveCount = particleLimit;
+}
+
+void ParticleEmitter::restart(uint32_t seed) {
+    clear();
+    stats = EmitterStats();
+    time = 0.0f;
+    rng.seed(seed);
 }
 
 void ParticleEmitter::update(float dt) {
+    PROFILE_SCOPE("ParticleEmitter::update");
+    liveCount = 0;
+    time += dt;
+    // Stats ride along in the same pass
+    glm::vec3 positionSum(0.0f);
+    float lifeLeftSum = 0.0f;
     for (auto &p : particles) {
         if (p.life > 0.0f) {
             p.life -= dt;
@@ -40,55 +94,91 @@ void ParticleEmitter::update(float dt) {
                 p.velocity += glm::vec3(0.0f, 0.5f * dt, 0.0f);
 
                 // Slight horizontal drift
-                float drift = 0.1f;
-                p.position.x += (glm::linearRand(-drift, drift) * dt);
-                p.position.z += (glm::linearRand(-drift, drift) * dt);
+                if (!turbulence) {
+                    float drift = 0.1f;
+                    p.position.x += (randomRange(-drift, drift) * dt);
+                    p.position.z += (randomRange(-drift, drift) * dt);
+                }
+                liveCount++;
+                positionSum += p.position;
+                lifeLeftSum += p.life;
             } else {
                 p.life = -1.0f;
             }
         }
     }
+    stats.liveCount = liveCount;
+    stats.centroid = liveCount > 0 ? positionSum / (float)liveCount : emissionPosition;
+    stats.meanAge = liveCount > 0 ? 1.0f - lifeLeftSum / (liveCount * lifeSpan) : 0.0f;
+    if (!turbulence) {
+        return;
+    }
+
+    // Coherent drift from the curl noise. Live particles are gathered in batches so the field
+    // lookups run over plain arrays.
+    float x[TURBULENCE_BATCH], y[TURBULENCE_BATCH], z[TURBULENCE_BATCH];
+    float vx[TURBULENCE_BATCH], vy[TURBULENCE_BATCH], vz[TURBULENCE_BATCH];
+    Particle *batch[TURBULENCE_BATCH];
+    float scroll = time * TURBULENCE_SCROLL;
+    float step = turbulenceStrength * dt;
+    size_t next = 0;
+    while (next < particles.size()) {
+        int count = 0;
+        for (; next < particles.size() && count < TURBULENCE_BATCH; next++) {
+            Particle &p = particles[next];
+            if (p.life > 0.0f) {
+                x[count] = p.position.x * turbulenceScale;
+                y[count] = p.position.y * turbulenceScale - scroll;
+                z[count] = p.position.z * turbulenceScale;
+                batch[count++] = &p;
+            }
+        }
+        turbulence->sample(x, y, z, vx, vy, vz, count);
+        for (int i = 0; i < count; i++) {
+            batch[i]->position += glm::vec3(vx[i], vy[i], vz[i]) * step;
+        }
+    }
 }
 
 void ParticleEmitter::emit(int count) {
-    for (int i = 0; i < count; i++) {
+    PROFILE_SCOPE("ParticleEmitter::emit");
+    for (int i = 0; i < count && liveCount < particleLimit; i++) {
         // Find a dead particle
         auto it = std::find_if(particles.begin(), particles.end(), [](const Particle &p){return p.life < 0.0f;});
         if (it != particles.end()) {
             // Adjust parameters based on emitter type
-            float radius, upSpeedMin, upSpeedMax, lifeSpan, sizeVal;
+            float radius, upSpeedMin, upSpeedMax, sizeVal;
             if (emitterType == EmitterType::CoreFlame) {
-                // Core flame: small, bright, short-lived, fast upward
+                // Core flame: small, bright, short-lived (lifeSpan), fast upward
                 radius = 0.01f;
                 upSpeedMin = 1.0f; upSpeedMax = 1.5f;
-                lifeSpan = 0.7f;
                 sizeVal = 15.0f;
             } else {
                 // Heat haze: slightly larger, more subtle, longer life but more transparent
                 radius = 0.05f;
                 upSpeedMin = 0.5f; upSpeedMax = 1.0f;
-                lifeSpan = 1.5f;
                 sizeVal = 20.0f;
             }
 
-            float xOffset = glm::linearRand(-radius, radius);
-            float zOffset = glm::linearRand(-radius, radius);
+            float xOffset = randomRange(-radius, radius);
+            float zOffset = randomRange(-radius, radius);
             it->position = emissionPosition + glm::vec3(xOffset, 0.02f, zOffset);
 
-            float upSpeed = glm::linearRand(upSpeedMin, upSpeedMax);
+            float upSpeed = randomRange(upSpeedMin, upSpeedMax);
             float horzSpread = 0.05f;
-            it->velocity = glm::vec3(glm::linearRand(-horzSpread, horzSpread),
+            it->velocity = glm::vec3(randomRange(-horzSpread, horzSpread),
                                      upSpeed,
-                                     glm::linearRand(-horzSpread, horzSpread));
+                                     randomRange(-horzSpread, horzSpread));
 
             it->life = lifeSpan; 
             it->size = sizeVal;
+            liveCount++;
         }
     }
 }
 
-void ParticleEmitter::draw() {
-    std::vector<float> positions;
+void ParticleEmitter::writePositions(std::vector<float> &positions) const {
+    positions.clear();
     for (auto &p : particles) {
         if (p.life > 0.0f) {
             positions.push_back(p.position.x);
@@ -96,10 +186,10 @@ void ParticleEmitter::draw() {
             positions.push_back(p.position.z);
         }
     }
+}
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferSubData(GL_ARRAY_BUFFER,0,positions.size()*sizeof(float),positions.data());
-    glDrawArrays(GL_POINTS,0,(GLsizei)(positions.size()/3));
-    glBindVertexArray(0);
+void ParticleEmitter::draw(const std::vector<float> &positions) {
+    PROFILE_SCOPE("ParticleEmitter::draw");
+    arena.updateStream(stream, positions.data(), positions.size()/3);
+    arena.drawArrays(stream, GL_POINTS, (GLsizei)(positions.size()/3));
 }
@@ -0,0 +1,102 @@
+#include "ParticleSort.h"
+#include "Profiler.h"
+#include <algorithm>
+
+static const int SORT_BLOCK = 1 << 14; // particles per job
+static const int RADIX = 256;
+
+ParticleSorter::ParticleSorter(ThreadPool &pool) : pool(pool) {}
+
+const std::vector<uint32_t> &ParticleSorter::sort(const float *positions, int count, const glm::mat4 &view) {
+    PROFILE_SCOPE("ParticleSorter::sort");
+    indices.resize(count);
+    if (count == 0) {
+        return indices;
+    }
+    depths.resize(count);
+    keys.resize(count);
+    keysTemp.resize(count);
+    indicesTemp.resize(count);
+    int blocks = (count + SORT_BLOCK - 1) / SORT_BLOCK;
+    blockMin.resize(blocks);
+    blockMax.resize(blocks);
+    histograms.resize((size_t)blocks * RADIX);
+
+    // View-space depth is -z, only the matrix's third row is needed
+    float rx = view[0][2], ry = view[1][2], rz = view[2][2], rw = view[3][2];
+    pool.parallelFor(blocks, 1, [&](int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            int first = b * SORT_BLOCK, last = std::min(first + SORT_BLOCK, count);
+            float lo = 1e30f, hi = -1e30f;
+            for (int i = first; i < last; i++) {
+                const float *p = positions + (size_t)i * 3;
+                float depth = -(rx * p[0] + ry * p[1] + rz * p[2] + rw);
+                depths[i] = depth;
+                lo = std::min(lo, depth);
+                hi = std::max(hi, depth);
+            }
+            blockMin[b] = lo;
+            blockMax[b] = hi;
+        }
+    });
+    float minDepth = *std::min_element(blockMin.begin(), blockMin.end());
+    float maxDepth = *std::max_element(blockMax.begin(), blockMax.end());
+    float scale = maxDepth > minDepth ? 65535.0f / (maxDepth - minDepth) : 0.0f;
+
+    // Keys (farthest = 0, so ascending order is back to front) and the low digit's histograms
+    pool.parallelFor(blocks, 1, [&](int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            int first = b * SORT_BLOCK, last = std::min(first + SORT_BLOCK, count);
+            uint32_t *histogram = &histograms[(size_t)b * RADIX];
+            std::fill(histogram, histogram + RADIX, 0u);
+            for (int i = first; i < last; i++) {
+                uint16_t key = (uint16_t)std::min((maxDepth - depths[i]) * scale + 0.5f, 65535.0f);
+                keys[i] = key;
+                indices[i] = (uint32_t)i;
+                histogram[key & 0xff]++;
+            }
+        }
+    });
+    scatter(keys.data(), indices.data(), keysTemp.data(), indicesTemp.data(), count, 0);
+
+    pool.parallelFor(blocks, 1, [&](int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            int first = b * SORT_BLOCK, last = std::min(first + SORT_BLOCK, count);
+            uint32_t *histogram = &histograms[(size_t)b * RADIX];
+            std::fill(histogram, histogram + RADIX, 0u);
+            for (int i = first; i < last; i++) {
+                histogram[keysTemp[i] >> 8]++;
+            }
+        }
+    });
+    scatter(keysTemp.data(), indicesTemp.data(), keys.data(), indices.data(), count, 8);
+    return indices;
+}
+
+void ParticleSorter::scatter(const uint16_t *srcKeys, const uint32_t *srcIndices, uint16_t *dstKeys,
+                             uint32_t *dstIndices, int count, int shift) {
+    // Counts -> output offsets, digit major so every block writes its items of a digit after
+    // those of the blocks before it
+    int blocks = (int)blockMin.size();
+    uint32_t offset = 0;
+    for (int digit = 0; digit < RADIX; digit++) {
+        for (int b = 0; b < blocks; b++) {
+            uint32_t &slot = histograms[(size_t)b * RADIX + digit];
+            uint32_t n = slot;
+            slot = offset;
+            offset += n;
+        }
+    }
+
+    pool.parallelFor(blocks, 1, [&](int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            int first = b * SORT_BLOCK, last = std::min(first + SORT_BLOCK, count);
+            uint32_t *cursor = &histograms[(size_t)b * RADIX];
+            for (int i = first; i < last; i++) {
+                uint32_t dst = cursor[(srcKeys[i] >> shift) & 0xff]++;
+                dstKeys[dst] = srcKeys[i];
+                dstIndices[dst] = srcIndices[i];
+            }
+        }
+    });
+}
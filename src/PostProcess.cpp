@@ -0,0 +1,203 @@
+#include "PostProcess.h"
+#include <algorithm>
+#include <iostream>
+
+// Reference: Marius Bjorge, "Bandwidth-Efficient Rendering", SIGGRAPH 2015 (dual filter blur)
+
+PostProcess::PostProcess(int width, int height, const BloomSettings &settings)
+: width(width), height(height), settings(settings), sceneFBO(0), sceneColorFBO(0), sceneColor(0), sceneDepth(0),
+  ldrFBO(0), ldrColor(0), emptyVAO(0),
+  downsampleShader("shaders/fullscreen.vert", "shaders/bloom_downsample.frag"),
+  upsampleShader("shaders/fullscreen.vert", "shaders/bloom_upsample.frag"),
+  tonemapShader("shaders/fullscreen.vert", "shaders/tonemap.frag"),
+  upscaleShader("shaders/fullscreen.vert", "shaders/upscale_sharpen.frag")
+{
+    glGenVertexArrays(1, &emptyVAO);
+    createTargets();
+}
+
+PostProcess::~PostProcess() {
+    destroyTargets();
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+static GLuint MakeTarget(GLint internalFormat, GLenum format, GLenum type, int width, int height, GLint filter) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+void PostProcess::createTargets() {
+    // Linear filtering on the scene color: the first downsample reads between texels
+    sceneColor = MakeTarget(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, width, height, GL_LINEAR);
+    sceneDepth = MakeTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height, GL_NEAREST);
+    glGenFramebuffers(1, &sceneFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "HDR framebuffer is incomplete" << std::endl;
+    }
+    glGenFramebuffers(1, &sceneColorFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneColorFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+
+    ldrColor = MakeTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height, GL_LINEAR);
+    glGenFramebuffers(1, &ldrFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, ldrFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ldrColor, 0);
+
+    // Bloom chain down to a few pixels, R11G11B10 would do but RGBA16F is guaranteed renderable
+    int w = width, h = height;
+    for (int i = 0; i < settings.maxLevels; i++) {
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+        BloomLevel level;
+        level.width = w;
+        level.height = h;
+        level.texture = MakeTarget(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, w, h, GL_LINEAR);
+        glGenFramebuffers(1, &level.FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, level.FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, level.texture, 0);
+        level.downName = "bloom_down_" + std::to_string(i);
+        level.upName = "bloom_up_" + std::to_string(i);
+        levels.push_back(level);
+        if (w == 1 && h == 1) {
+            break;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PostProcess::destroyTargets() {
+    for (BloomLevel &level : levels) {
+        glDeleteFramebuffers(1, &level.FBO);
+        glDeleteTextures(1, &level.texture);
+    }
+    levels.clear();
+    glDeleteFramebuffers(1, &sceneFBO);
+    glDeleteFramebuffers(1, &sceneColorFBO);
+    glDeleteTextures(1, &sceneColor);
+    glDeleteTextures(1, &sceneDepth);
+    glDeleteFramebuffers(1, &ldrFBO);
+    glDeleteTextures(1, &ldrColor);
+}
+
+void PostProcess::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    destroyTargets();
+    createTargets();
+}
+
+void PostProcess::beginScene(const glm::vec4 &clearColor) {
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glViewport(0, 0, width, height);
+    glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void PostProcess::drawFullscreen() {
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void PostProcess::resolve(GpuTimer &timer, GLuint outputFramebuffer, int outputWidth, int outputHeight) {
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    GLint blendSrc, blendDst;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDst);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glBindVertexArray(emptyVAO);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Downsample chain, the first pass also applies the soft threshold
+    downsampleShader.use();
+    downsampleShader.setInt("uSource", 0);
+    downsampleShader.setFloat("uThreshold", settings.threshold);
+    downsampleShader.setFloat("uKnee", settings.knee);
+    GLuint source = sceneColor;
+    int sourceWidth = width, sourceHeight = height;
+    for (size_t i = 0; i < levels.size(); i++) {
+        const BloomLevel &level = levels[i];
+        timer.begin(level.downName);
+        glBindFramebuffer(GL_FRAMEBUFFER, level.FBO);
+        glViewport(0, 0, level.width, level.height);
+        glBindTexture(GL_TEXTURE_2D, source);
+        downsampleShader.setInt("uPrefilter", i == 0);
+        downsampleShader.setVec2("uHalfTexel", glm::vec2(0.5f / sourceWidth, 0.5f / sourceHeight));
+        drawFullscreen();
+        timer.end(level.downName);
+        source = level.texture;
+        sourceWidth = level.width;
+        sourceHeight = level.height;
+    }
+
+    // Upsample back up, adding each blurred level onto the next larger one
+    upsampleShader.use();
+    upsampleShader.setInt("uSource", 0);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (int i = (int)levels.size() - 1; i > 0; i--) {
+        const BloomLevel &from = levels[i];
+        const BloomLevel &to = levels[i - 1];
+        timer.begin(to.upName);
+        glBindFramebuffer(GL_FRAMEBUFFER, to.FBO);
+        glViewport(0, 0, to.width, to.height);
+        glBindTexture(GL_TEXTURE_2D, from.texture);
+        upsampleShader.setVec2("uHalfTexel", glm::vec2(0.5f / from.width, 0.5f / from.height));
+        drawFullscreen();
+        timer.end(to.upName);
+    }
+    glDisable(GL_BLEND);
+    glBlendFunc(blendSrc, blendDst);
+
+    // Tonemap into the output, upsampling the last bloom level on the way. Below the output
+    // resolution it goes to the LDR target first, sharpening works best after the tonemap.
+    bool upscale = outputWidth != width || outputHeight != height;
+    timer.begin("tonemap");
+    glBindFramebuffer(GL_FRAMEBUFFER, upscale ? ldrFBO : outputFramebuffer);
+    glViewport(0, 0, width, height);
+    tonemapShader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, levels.empty() ? 0 : levels[0].texture);
+    glActiveTexture(GL_TEXTURE0);
+    tonemapShader.setInt("uScene", 0);
+    tonemapShader.setInt("uBloom", 1);
+    tonemapShader.setVec2("uBloomHalfTexel", levels.empty() ? glm::vec2(0.0f)
+                          : glm::vec2(0.5f / levels[0].width, 0.5f / levels[0].height));
+    tonemapShader.setFloat("uBloomStrength", levels.empty() ? 0.0f : settings.strength);
+    tonemapShader.setFloat("uExposure", settings.exposure);
+    drawFullscreen();
+    timer.end("tonemap");
+
+    if (upscale) {
+        timer.begin("upscale");
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        glViewport(0, 0, outputWidth, outputHeight);
+        upscaleShader.use();
+        glBindTexture(GL_TEXTURE_2D, ldrColor);
+        upscaleShader.setInt("uSource", 0);
+        upscaleShader.setVec2("uSourceTexel", glm::vec2(1.0f / width, 1.0f / height));
+        upscaleShader.setFloat("uSharpness", settings.sharpness);
+        drawFullscreen();
+        timer.end("upscale");
+    }
+
+    glBindVertexArray(0);
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+    if (blend) glEnable(GL_BLEND);
+}
@@ -0,0 +1,140 @@
+#include "Profiler.h"
+
+#ifdef CANDLE_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// One ring per thread, written only by its thread. The exporter reads concurrently, seqlock
+// style: `reserved` moves before a slot is overwritten and `written` after, so the reader can
+// tell which of the slots it copied may have been overwritten meanwhile and drops those.
+struct ProfileEvent {
+    std::atomic<const char *> name{nullptr};
+    std::atomic<uint64_t> start{0}, end{0};
+};
+
+struct ProfileThread {
+    std::vector<ProfileEvent> events = std::vector<ProfileEvent>(PROFILER_RING_SIZE);
+    std::atomic<uint64_t> reserved{0};
+    std::atomic<uint64_t> written{0};
+    int id = 0;
+    std::string name;   // guarded by the registry mutex
+};
+
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<ProfileThread>> registry; // rings outlive their threads
+static thread_local ProfileThread *currentThread = nullptr;
+static const auto startTime = std::chrono::steady_clock::now();
+
+static ProfileThread *threadRing() {
+    if (!currentThread) {
+        // Once per thread, the only lock outside of export
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.emplace_back(new ProfileThread());
+        currentThread = registry.back().get();
+        currentThread->id = (int)registry.size();
+        currentThread->name = "thread " + std::to_string(currentThread->id);
+    }
+    return currentThread;
+}
+
+uint64_t profilerNow() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+void profilerRecord(const char *name, uint64_t start, uint64_t end) {
+    ProfileThread *thread = threadRing();
+    uint64_t index = thread->written.load(std::memory_order_relaxed);
+    thread->reserved.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ProfileEvent &event = thread->events[index & (PROFILER_RING_SIZE - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    thread->written.store(index + 1, std::memory_order_release);
+}
+
+void profilerSetThreadName(const std::string &name) {
+    ProfileThread *thread = threadRing();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    thread->name = name;
+}
+
+static void writeJsonString(std::ostream &out, const char *text) {
+    out << '"';
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+bool writeChromeTrace(const std::string &path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write trace: " << path << std::endl;
+        return false;
+    }
+
+    struct Copied { const char *name; uint64_t start, end; };
+    std::vector<Copied> copied;
+    bool first = true;
+    auto separator = [&]() -> std::ostream & {
+        file << (first ? "\n" : ",\n");
+        first = false;
+        return file;
+    };
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::unique_ptr<ProfileThread> &thread : registry) {
+        uint64_t written = thread->written.load(std::memory_order_acquire);
+        uint64_t begin = written > (uint64_t)PROFILER_RING_SIZE ? written - PROFILER_RING_SIZE : 0;
+        copied.clear();
+        for (uint64_t i = begin; i < written; i++) {
+            const ProfileEvent &event = thread->events[i & (PROFILER_RING_SIZE - 1)];
+            copied.push_back({event.name.load(std::memory_order_relaxed),
+                              event.start.load(std::memory_order_relaxed),
+                              event.end.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Slot i was overwritten once the writer reserved index i + ring size
+        uint64_t reserved = thread->reserved.load(std::memory_order_relaxed);
+        uint64_t firstValid = reserved > (uint64_t)PROFILER_RING_SIZE ? reserved - PROFILER_RING_SIZE : 0;
+
+        separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id
+                    << ",\"args\":{\"name\":";
+        writeJsonString(file, thread->name.c_str());
+        file << "}}";
+        for (size_t i = 0; i < copied.size(); i++) {
+            if (begin + i < firstValid || !copied[i].name) {
+                continue;
+            }
+            // Complete events, times in microseconds
+            separator() << "{\"name\":";
+            writeJsonString(file, copied[i].name);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id
+                 << ",\"ts\":" << copied[i].start / 1000.0
+                 << ",\"dur\":" << (copied[i].end - copied[i].start) / 1000.0 << "}";
+        }
+    }
+    file << "\n]}\n";
+    if (!file.good()) {
+        std::cerr << "Failed to write trace: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -1,4 +1,8 @@
 #include "RoomModel.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "Profiler.h"
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #define STB_IMAGE_IMPLEMENTATION
@@ -8,182 +12,224 @@
 // We'll assume the texture coordinates align such that x increases in U direction and y in V direction for walls.
 // For each face, we can deduce a suitable tangent and bitangent.
 
-// Each vertex now: pos(3), normal(3), texCoord(2), tangent(3), bitangent(3) = total 14 floats per vertex
-// We'll define a helper to add a face with known orientation and tangents.
-
-static void AddFace(std::vector<float> &vertices,
-                    float x1, float y1, float z1,
-                    float x2, float y2, float z2,
-                    float x3, float y3, float z3,
-                    float x4, float y4, float z4,
-                    float nx, float ny, float nz,
-                    // We assume a simple mapping: top-left is (0,0), top-right is (1,0), bottom-right(1,1), bottom-left(0,1)
-                    float tx, float ty, float tz,
-                    float bx, float by, float bz)
-{
-    // uv mapping: we define a quad with (0,0) top-left, (1,0) top-right, (1,1) bottom-right, (0,1) bottom-left
-    // We'll add vertices in a "triangle fan" order: v1-v2-v3-v4 forming a quad.
-
-    auto addVertex = [&](float x, float y, float z, float u, float v) {
-        vertices.push_back(x); vertices.push_back(y); vertices.push_back(z); // pos
-        vertices.push_back(nx); vertices.push_back(ny); vertices.push_back(nz); // normal
-        vertices.push_back(u); vertices.push_back(v); // texCoord
-        vertices.push_back(tx); vertices.push_back(ty); vertices.push_back(tz); // tangent
-        vertices.push_back(bx); vertices.push_back(by); vertices.push_back(bz); // bitangent
-    };
-
-    // Top-left (0,0)
-    addVertex(x1,y1,z1, 0.0f,0.0f);
-    // Top-right (1,0)
-    addVertex(x2,y2,z2, 1.0f,0.0f);
-    // Bottom-right (1,1)
-    addVertex(x3,y3,z3, 1.0f,1.0f);
-    // Bottom-left (0,1)
-    addVertex(x4,y4,z4, 0.0f,1.0f);
-}
+// Each vertex now: pos(3), normal(3), texCoord(2), tangent(3), bitangent(3), lightmapCoord(2) = total 16 floats per vertex
+// We'll describe the faces once in a table; the mesh and the lightmap baker both read it.
 
-RoomModel::RoomModel() : VAO(0), VBO(0), vertexCount(0) {
-    float size = 5.0f; // half-room size
+struct RoomFace {
+    // We assume a simple mapping: top-left is (0,0), top-right is (1,0), bottom-right(1,1), bottom-left(0,1)
+    glm::vec3 corners[4];
+    glm::vec3 normal;
+    glm::vec3 tangent;
+    glm::vec3 bitangent;
+};
 
+static std::vector<RoomFace> RoomFaces(float size) {
     // We'll build the room from 6 faces: floor, ceiling, left wall, right wall, front wall, back wall
     // For tangent and bitangent:
     // If we consider that the U axis goes along the X direction, and V along the Z direction (for floor/ceiling),
     // we pick tangent = (1,0,0) and bitangent = (0,0,1).
     // For walls, we must choose accordingly to map U along horizontal and V along vertical for instance.
+    return {
+        // Floor (y=-size), normal=(0,1,0)
+        // Texture plane along x and z: U -> x increasing, V -> z increasing
+        {{{-size, -size, -size}, { size, -size, -size}, { size, -size,  size}, {-size, -size,  size}},
+         {0,1,0},
+         {1,0,0},   // tangent along X
+         {0,0,1}},  // bitangent along Z
+
+        // Ceiling (y=+size), normal=(0,-1,0)
+        // U->x, V->-z to keep consistent
+        // For simplicity, we still say tangent=(1,0,0) and bitangent=(0,0,-1) since if we look down, z axis inverts.
+        {{{-size, size,  size}, { size, size,  size}, { size, size, -size}, {-size, size, -size}},
+         {0,-1,0}, {1,0,0}, {0,0,-1}},
+
+        // Left wall (x=-size), normal=(1,0,0) if we want inside normals pointing inward
+        // Let's say U->z, V->y.
+        // If U is along Z increasing and V along Y increasing, tangent=(0,0,1), bitangent=(0,1,0).
+        {{{-size, -size,  size}, {-size,  size,  size}, {-size,  size, -size}, {-size, -size, -size}},
+         {1,0,0}, {0,0,1}, {0,1,0}},
+
+        // Right wall (x=+size), normal=(-1,0,0)
+        // Similarly U->-z, V->y: tangent=(0,0,-1), bitangent=(0,1,0)
+        {{{ size, -size, -size}, { size,  size, -size}, { size,  size,  size}, { size, -size,  size}},
+         {-1,0,0}, {0,0,-1}, {0,1,0}},
+
+        // Front wall (z=-size), normal=(0,0,1)
+        // If we choose U->x, V->y: tangent=(1,0,0), bitangent=(0,1,0)
+        {{{-size,  size, -size}, { size,  size, -size}, { size, -size, -size}, {-size, -size, -size}},
+         {0,0,1}, {1,0,0}, {0,1,0}},
+
+        // Back wall (z=+size), normal=(0,0,-1)
+        // U->-x, V->y: tangent=(-1,0,0), bitangent=(0,1,0)
+        {{{ size,  size,  size}, {-size,  size,  size}, {-size, -size,  size}, { size, -size,  size}},
+         {0,0,-1}, {-1,0,0}, {0,1,0}},
+    };
+}
+
+static LightmapSettings RoomLightmapSettings(float size) {
+    LightmapSettings settings;
+    settings.faceResolution = 128;
+    settings.bounceSamples = 16;
+    settings.boundsMin = glm::vec3(-size);
+    settings.boundsMax = glm::vec3(size);
+    return settings;
+}
+
+static void AddFace(MeshData &mesh, const RoomFace &face, int faceIndex, int faceCount,
+                    const LightmapSettings &lightmap)
+{
+    // uv mapping: we define a quad with (0,0) top-left, (1,0) top-right, (1,1) bottom-right, (0,1) bottom-left
+    // We'll add vertices in a "triangle fan" order: v1-v2-v3-v4 forming a quad, split into two indexed triangles.
+    std::vector<float> &vertices = mesh.vertices;
+    unsigned int base = (unsigned int)mesh.vertexCount();
+
+    static const float cornerUV[4][2] = { {0.0f,0.0f}, {1.0f,0.0f}, {1.0f,1.0f}, {0.0f,1.0f} };
+    for (int c = 0; c < 4; c++) {
+        const glm::vec3 &p = face.corners[c];
+        float u = cornerUV[c][0], v = cornerUV[c][1];
+        glm::vec2 lightmapUV = lightmapCoord(faceIndex, faceCount, u, v, lightmap);
+        float vertex[16] = {
+            p.x, p.y, p.z,                                      // pos
+            face.normal.x, face.normal.y, face.normal.z,        // normal
+            u, v,                                               // texCoord
+            face.tangent.x, face.tangent.y, face.tangent.z,     // tangent
+            face.bitangent.x, face.bitangent.y, face.bitangent.z, // bitangent
+            lightmapUV.x, lightmapUV.y                          // lightmap texCoord
+        };
+        vertices.insert(vertices.end(), vertex, vertex + 16);
+    }
+
+    unsigned int quad[6] = { base, base+1, base+2, base, base+2, base+3 };
+    mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+}
+
+// Bump when the room geometry or the optimizer output changes, it invalidates cached meshes
+static const uint32_t ROOM_MESH_VERSION = 2;
+
+static MeshData BuildRoomMesh(float size) {
+    MeshData mesh;
+    mesh.floatsPerVertex = 16;
+
+    std::vector<RoomFace> faces = RoomFaces(size);
+    LightmapSettings lightmap = RoomLightmapSettings(size);
+    for (size_t i = 0; i < faces.size(); i++) {
+        AddFace(mesh, faces[i], (int)i, (int)faces.size(), lightmap);
+    }
 
-    std::vector<float> vertices;
-
-    // Floor (y=-size), normal=(0,1,0)
-    // Texture plane along x and z: U -> x increasing, V -> z increasing
-    AddFace(vertices,
-        -size, -size, -size,
-         size, -size, -size,
-         size, -size,  size,
-        -size, -size,  size,
-        0,1,0,
-        1,0,0, // tangent along X
-        0,0,1  // bitangent along Z
-    );
-
-    // Ceiling (y=+size), normal=(0,-1,0)
-    // U->x, V->-z to keep consistent
-    // For simplicity, we still say tangent=(1,0,0) and bitangent=(0,0,-1) since if we look down, z axis inverts.
-    AddFace(vertices,
-        -size, size,  size,
-         size, size,  size,
-         size, size, -size,
-        -size, size, -size,
-        0,-1,0,
-        1,0,0,
-        0,0,-1
-    );
-
-    // Left wall (x=-size), normal=(1,0,0) if we want inside normals pointing inward
-    // Let's say U->z, V->y. 
-    // If U is along Z increasing and V along Y increasing, tangent=(0,0,1), bitangent=(0,1,0).
-    AddFace(vertices,
-        -size, -size,  size,
-        -size,  size,  size,
-        -size,  size, -size,
-        -size, -size, -size,
-        1,0,0,
-        0,0,1,
-        0,1,0
-    );
-
-    // Right wall (x=+size), normal=(-1,0,0)
-    // Similarly U->-z, V->y: tangent=(0,0,-1), bitangent=(0,1,0)
-    AddFace(vertices,
-         size, -size, -size,
-         size,  size, -size,
-         size,  size,  size,
-         size, -size,  size,
-        -1,0,0,
-        0,0,-1,
-        0,1,0
-    );
-
-    // Front wall (z=-size), normal=(0,0,1)
-    // If we choose U->x, V->y: tangent=(1,0,0), bitangent=(0,1,0)
-    AddFace(vertices,
-        -size,  size, -size,
-         size,  size, -size,
-         size, -size, -size,
-        -size, -size, -size,
-        0,0,1,
-        1,0,0,
-        0,1,0
-    );
-
-    // Back wall (z=+size), normal=(0,0,-1)
-    // U->-x, V->y: tangent=(-1,0,0), bitangent=(0,1,0)
-    AddFace(vertices,
-         size,  size,  size,
-        -size,  size,  size,
-        -size, -size,  size,
-         size, -size,  size,
-        0,0,-1,
-        -1,0,0,
-        0,1,0
-    );
-
-    vertexCount = (int)(vertices.size() / 14); // 14 floats per vertex
-
-    glGenVertexArrays(1,&VAO);
-    glBindVertexArray(VAO);
-
-    glGenBuffers(1,&VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-    // position (3 floats)
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,14*sizeof(float),(void*)0);
-    glEnableVertexAttribArray(0);
-    // normal (3 floats)
-    glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,14*sizeof(float),(void*)(3*sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // texcoord (2 floats)
-    glVertexAttribPointer(2,2,GL_FLOAT,GL_FALSE,14*sizeof(float),(void*)(6*sizeof(float)));
-    glEnableVertexAttribArray(2);
-    // tangent (3 floats)
-    glVertexAttribPointer(3,3,GL_FLOAT,GL_FALSE,14*sizeof(float),(void*)(8*sizeof(float)));
-    glEnableVertexAttribArray(3);
-    // bitangent (3 floats)
-    glVertexAttribPointer(4,3,GL_FLOAT,GL_FALSE,14*sizeof(float),(void*)(11*sizeof(float)));
-    glEnableVertexAttribArray(4);
-
-    glBindVertexArray(0);
-
-    albedoTexture = loadTexture("textures/wood_albedo.jpg");
+    optimizeMesh(mesh);
+    return mesh;
+}
+
+RoomModel::RoomModel(BufferArena &arena) : arena(arena), size(5.0f) { // half-room size
+    VertexLayout layout;
+    layout.stride = 16*sizeof(float);
+    layout.attributes = {
+        {0, 3, 0},                  // position (3 floats)
+        {1, 3, 3*sizeof(float)},    // normal (3 floats)
+        {2, 2, 6*sizeof(float)},    // texcoord (2 floats)
+        {3, 3, 8*sizeof(float)},    // tangent (3 floats)
+        {4, 3, 11*sizeof(float)},   // bitangent (3 floats)
+        {5, 2, 14*sizeof(float)}    // lightmap texcoord (2 floats)
+    };
+
+    // Geometry is cached on disk keyed on its parameters, later runs just map the file
+    LightmapSettings lightmap = RoomLightmapSettings(size);
+    uint64_t key = hashBytes(&ROOM_MESH_VERSION, sizeof(ROOM_MESH_VERSION));
+    key = hashBytes(&size, sizeof(size), key);
+    key = hashBytes(&lightmap.faceResolution, sizeof(lightmap.faceResolution), key);
+    std::string cachePath = meshCachePath("room", key);
+
+    MeshFile file;
+    MeshData generated;
+    if (!file.open(cachePath, key)) {
+        generated = BuildRoomMesh(size);
+        // 24 vertices, 16-bit indices are always enough here
+        if (writeMeshFile(cachePath, key, layout, generated, 2, {})) {
+            file.open(cachePath, key);
+        }
+    }
+
+    if (file.isOpen()) {
+        // Upload straight from the mapped file
+        const MeshFileHeader &header = file.getHeader();
+        mesh = arena.allocateMesh(layout, file.vertexData(), header.vertexCount,
+                                  file.indexData(), header.indexCount, header.indexSize);
+    } else {
+        mesh = arena.allocateMesh(layout, generated.vertices.data(), generated.vertexCount(),
+                                  generated.indices.data(), generated.indices.size(), 4);
+    }
+
+    albedoTexture = loadTexture("textures/wood_albedo.jpg", &averageAlbedo);
     normalTexture = loadTexture("textures/wood_normal.jpg");
+    lightmapTexture = 0;
+}
+
+void RoomModel::bakeLightmap(ThreadPool &pool, const std::vector<PointLight> &lights,
+                             const std::vector<LightmapBox> &occluders) {
+    std::vector<LightmapFace> faces;
+    for (const RoomFace &face : RoomFaces(size)) {
+        faces.push_back({face.corners[0], face.corners[1] - face.corners[0],
+                         face.corners[3] - face.corners[0], face.normal});
+    }
+    LightmapSettings settings = RoomLightmapSettings(size);
+    settings.bounceAlbedo = averageAlbedo;
+    int width = lightmapWidth(settings);
+    int height = lightmapHeight((int)faces.size(), settings);
+
+    // Baking takes a moment, so the result is cached keyed on lights, occluders and settings
+    uint64_t key = lightmapKey(faces, lights, occluders, settings);
+    std::string cachePath = cacheFilePath("room_lightmap", key, "lmap");
+    std::vector<float> texels;
+    if (!readLightmapFile(cachePath, key, width, height, texels)) {
+        texels = ::bakeLightmap(pool, faces, lights, occluders, settings);
+        writeLightmapFile(cachePath, key, width, height, texels);
+    }
+
+    if (lightmapTexture == 0) {
+        glGenTextures(1, &lightmapTexture);
+    }
+    glBindTexture(GL_TEXTURE_2D, lightmapTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, texels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 RoomModel::~RoomModel() {
-    glDeleteBuffers(1,&VBO);
-    glDeleteVertexArrays(1,&VAO);
+    arena.freeMesh(mesh);
     glDeleteTextures(1,&albedoTexture);
     glDeleteTextures(1,&normalTexture);
+    if (lightmapTexture) {
+        glDeleteTextures(1,&lightmapTexture);
+    }
 }
 
 void RoomModel::draw() {
-    glBindVertexArray(VAO);
-
     // We'll bind textures in main.cpp before calling draw(), 
     // so here we just draw the geometry.
-    // 6 faces * 4 vertices each, drawn as triangle fan means we can still do:
-    for (int i = 0; i < 6; i++) {
-        glDrawArrays(GL_TRIANGLE_FAN, i*4, 4);
-    }
-    glBindVertexArray(0);
+    // 6 faces * 2 indexed triangles each, in a single call
+    arena.drawElements(mesh, GL_TRIANGLES, mesh.indexCount());
 }
 
-GLuint RoomModel::loadTexture(const char* path) {
+GLuint RoomModel::loadTexture(const char* path, glm::vec3 *average) {
+    PROFILE_SCOPE("RoomModel::loadTexture");
     int w,h,n;
     unsigned char* data = stbi_load(path,&w,&h,&n,3);
     if(!data){
         std::cerr << "Failed to load texture: " << path << std::endl;
         return 0;
     }
+    if (average) {
+        // The lightmap baker bounces light off the mean wall color
+        double sum[3] = {0.0, 0.0, 0.0};
+        for (int i = 0; i < w*h; i++) {
+            for (int c = 0; c < 3; c++) sum[c] += data[i*3 + c];
+        }
+        double scale = 1.0 / (255.0 * std::max(w*h, 1));
+        *average = glm::vec3((float)(sum[0]*scale), (float)(sum[1]*scale), (float)(sum[2]*scale));
+    }
     GLuint tex;
     glGenTextures(1,&tex);
     glBindTexture(GL_TEXTURE_2D, tex);
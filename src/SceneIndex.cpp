@@ -0,0 +1,276 @@
+#include "SceneIndex.h"
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SCENE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+Frustum frustumFromMatrix(const glm::mat4 &m) {
+    // Rows of the matrix, glm is column major
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++) {
+        row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    }
+    Frustum frustum;
+    frustum.planes[0] = row[3] + row[0]; // left
+    frustum.planes[1] = row[3] - row[0]; // right
+    frustum.planes[2] = row[3] + row[1]; // bottom
+    frustum.planes[3] = row[3] - row[1]; // top
+    frustum.planes[4] = row[3] + row[2]; // near
+    frustum.planes[5] = row[3] - row[2]; // far
+    return frustum;
+}
+
+static float SurfaceArea(const Aabb &box) {
+    glm::vec3 d = box.max - box.min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static Aabb Merge(const Aabb &a, const Aabb &b) {
+    return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+// Reorders ids so the first k have the smaller centroids along the box's longest centroid axis
+static void SplitMedian(const std::vector<Aabb> &objects, int *ids, int count, int k) {
+    glm::vec3 lo = objects[ids[0]].min + objects[ids[0]].max;
+    glm::vec3 hi = lo;
+    for (int i = 1; i < count; i++) {
+        glm::vec3 c = objects[ids[i]].min + objects[ids[i]].max;
+        lo = glm::min(lo, c);
+        hi = glm::max(hi, c);
+    }
+    glm::vec3 extent = hi - lo;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    std::nth_element(ids, ids + k, ids + count, [&](int a, int b) {
+        return objects[a].min[axis] + objects[a].max[axis] < objects[b].min[axis] + objects[b].max[axis];
+    });
+}
+
+SceneIndex::SceneIndex()
+: objectCount(0), dirty(true), buildArea(0.0f), area(0.0f), rebuilds(0)
+{}
+
+int SceneIndex::add(const Aabb &bounds) {
+    int id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = (int)objects.size();
+        objects.emplace_back();
+        alive.push_back(0);
+        leafNode.push_back(-1);
+        leafSlot.push_back(-1);
+    }
+    objects[id] = bounds;
+    alive[id] = 1;
+    objectCount++;
+    dirty = true;
+    return id;
+}
+
+void SceneIndex::remove(int id) {
+    if (id < 0 || id >= (int)objects.size() || !alive[id]) {
+        return;
+    }
+    alive[id] = 0;
+    freeIds.push_back(id);
+    objectCount--;
+    dirty = true;
+}
+
+void SceneIndex::setBounds(int id, const Aabb &bounds) {
+    objects[id] = bounds;
+    if (dirty) {
+        return; // the rebuild picks it up
+    }
+
+    // Refit the leaf slot, then every ancestor's slot for the node below it
+    int node = leafNode[id];
+    setSlot(node, leafSlot[id], bounds);
+    while (nodes[node].parent >= 0) {
+        int parent = nodes[node].parent;
+        setSlot(parent, nodes[node].parentSlot, nodeBounds(nodes[node]));
+        node = parent;
+    }
+    if (area > buildArea * REBUILD_AREA_RATIO) {
+        dirty = true;
+    }
+}
+
+void SceneIndex::setSlot(int nodeIndex, int slot, const Aabb &bounds) {
+    Node &node = nodes[nodeIndex];
+    Aabb old = { glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]),
+                 glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]) };
+    area += SurfaceArea(bounds) - SurfaceArea(old);
+    node.minX[slot] = bounds.min.x; node.minY[slot] = bounds.min.y; node.minZ[slot] = bounds.min.z;
+    node.maxX[slot] = bounds.max.x; node.maxY[slot] = bounds.max.y; node.maxZ[slot] = bounds.max.z;
+}
+
+Aabb SceneIndex::nodeBounds(const Node &node) const {
+    Aabb bounds = { glm::vec3(node.minX[0], node.minY[0], node.minZ[0]),
+                    glm::vec3(node.maxX[0], node.maxY[0], node.maxZ[0]) };
+    for (int slot = 1; slot < 4 && node.child[slot] != EMPTY_SLOT; slot++) {
+        bounds = Merge(bounds, { glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]),
+                                 glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]) });
+    }
+    return bounds;
+}
+
+void SceneIndex::rebuild() {
+    nodes.clear();
+    area = 0.0f;
+    std::vector<int> ids;
+    ids.reserve(objectCount);
+    for (int id = 0; id < (int)objects.size(); id++) {
+        if (alive[id]) {
+            ids.push_back(id);
+        }
+    }
+    if (!ids.empty()) {
+        build(ids.data(), (int)ids.size(), -1, -1);
+    }
+    buildArea = area;
+    dirty = false;
+    rebuilds++;
+}
+
+int SceneIndex::build(int *ids, int count, int parent, int parentSlot) {
+    int index = (int)nodes.size();
+    nodes.emplace_back();
+    Node &node = nodes.back();
+    for (int slot = 0; slot < 4; slot++) {
+        node.minX[slot] = node.minY[slot] = node.minZ[slot] = 0.0f;
+        node.maxX[slot] = node.maxY[slot] = node.maxZ[slot] = 0.0f;
+        node.child[slot] = EMPTY_SLOT;
+    }
+    node.parent = parent;
+    node.parentSlot = parentSlot;
+
+    // Two levels of median splits give the four children
+    int *groupIds[4];
+    int groupCount[4];
+    int groups = 0;
+    if (count <= 4) {
+        for (int i = 0; i < count; i++) {
+            groupIds[groups] = ids + i;
+            groupCount[groups++] = 1;
+        }
+    } else {
+        int half = count / 2;
+        SplitMedian(objects, ids, count, half);
+        SplitMedian(objects, ids, half, half / 2);
+        SplitMedian(objects, ids + half, count - half, (count - half) / 2);
+        groupIds[0] = ids;                                groupCount[0] = half / 2;
+        groupIds[1] = ids + half / 2;                     groupCount[1] = half - half / 2;
+        groupIds[2] = ids + half;                         groupCount[2] = (count - half) / 2;
+        groupIds[3] = ids + half + (count - half) / 2;    groupCount[3] = count - half - (count - half) / 2;
+        groups = 4;
+    }
+
+    // Children are built first, the vector may reallocate under a reference to this node
+    for (int g = 0; g < groups; g++) {
+        if (groupCount[g] == 1) {
+            int id = groupIds[g][0];
+            nodes[index].child[g] = ~id;
+            leafNode[id] = index;
+            leafSlot[id] = g;
+            setSlot(index, g, objects[id]);
+        } else {
+            int child = build(groupIds[g], groupCount[g], index, g);
+            nodes[index].child[g] = child;
+            setSlot(index, g, nodeBounds(nodes[child]));
+        }
+    }
+    return index;
+}
+
+void SceneIndex::testNode(const Node &node, const Frustum &frustum, int &outside, int &inside) {
+    // Per plane, the box corner furthest along the normal decides "outside", the nearest one
+    // decides "inside". The normal's signs are the same for all four boxes, so picking the
+    // corner is a choice between the min and max arrays.
+#ifdef SCENE_SSE
+    const __m128 zero = _mm_setzero_ps();
+    __m128 out = zero;
+    __m128 in = _mm_cmpeq_ps(zero, zero);
+    const __m128 minX = _mm_load_ps(node.minX), minY = _mm_load_ps(node.minY), minZ = _mm_load_ps(node.minZ);
+    const __m128 maxX = _mm_load_ps(node.maxX), maxY = _mm_load_ps(node.maxY), maxZ = _mm_load_ps(node.maxZ);
+    for (const glm::vec4 &plane : frustum.planes) {
+        const __m128 a = _mm_set1_ps(plane.x), b = _mm_set1_ps(plane.y), c = _mm_set1_ps(plane.z);
+        const __m128 d = _mm_set1_ps(plane.w);
+        __m128 furthest = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, plane.x >= 0.0f ? maxX : minX),
+                                                _mm_mul_ps(b, plane.y >= 0.0f ? maxY : minY)),
+                                     _mm_add_ps(_mm_mul_ps(c, plane.z >= 0.0f ? maxZ : minZ), d));
+        __m128 nearest = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, plane.x >= 0.0f ? minX : maxX),
+                                               _mm_mul_ps(b, plane.y >= 0.0f ? minY : maxY)),
+                                    _mm_add_ps(_mm_mul_ps(c, plane.z >= 0.0f ? minZ : maxZ), d));
+        out = _mm_or_ps(out, _mm_cmplt_ps(furthest, zero));
+        in = _mm_and_ps(in, _mm_cmpge_ps(nearest, zero));
+    }
+    outside = _mm_movemask_ps(out);
+    inside = _mm_movemask_ps(in) & ~outside;
+#else
+    outside = 0;
+    inside = 0;
+    for (int lane = 0; lane < 4; lane++) {
+        bool out = false, in = true;
+        for (const glm::vec4 &plane : frustum.planes) {
+            float furthest = plane.x * (plane.x >= 0.0f ? node.maxX[lane] : node.minX[lane])
+                           + plane.y * (plane.y >= 0.0f ? node.maxY[lane] : node.minY[lane])
+                           + plane.z * (plane.z >= 0.0f ? node.maxZ[lane] : node.minZ[lane]) + plane.w;
+            float nearest = plane.x * (plane.x >= 0.0f ? node.minX[lane] : node.maxX[lane])
+                          + plane.y * (plane.y >= 0.0f ? node.minY[lane] : node.maxY[lane])
+                          + plane.z * (plane.z >= 0.0f ? node.minZ[lane] : node.maxZ[lane]) + plane.w;
+            out = out || furthest < 0.0f;
+            in = in && nearest >= 0.0f;
+        }
+        if (out) {
+            outside |= 1 << lane;
+        } else if (in) {
+            inside |= 1 << lane;
+        }
+    }
+#endif
+}
+
+void SceneIndex::collect(int child, std::vector<int> &visible) const {
+    if (child < 0) {
+        visible.push_back(~child);
+        return;
+    }
+    const Node &node = nodes[child];
+    for (int slot = 0; slot < 4 && node.child[slot] != EMPTY_SLOT; slot++) {
+        collect(node.child[slot], visible);
+    }
+}
+
+void SceneIndex::cull(const Frustum &frustum, std::vector<int> &visible) {
+    if (dirty) {
+        rebuild();
+    }
+    if (nodes.empty()) {
+        return;
+    }
+
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+
+        int outside, inside;
+        testNode(node, frustum, outside, inside);
+        for (int slot = 0; slot < 4 && node.child[slot] != EMPTY_SLOT; slot++) {
+            int child = node.child[slot];
+            if (outside & (1 << slot)) {
+                continue;
+            }
+            if ((inside & (1 << slot)) || child < 0) {
+                collect(child, visible); // whole subtree in view, no more tests
+            } else {
+                stack.push_back(child);
+            }
+        }
+    }
+}
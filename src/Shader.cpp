@@ -1,4 +1,5 @@
 #include "Shader.h"
+#include "Profiler.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -6,6 +7,7 @@
 Shader::Shader() : ID(0) {}
 
 Shader::Shader(const std::string &vertexPath, const std::string &fragmentPath) {
+    PROFILE_SCOPE("Shader::Shader");
     std::string vSrc = loadSource(vertexPath);
     std::string fSrc = loadSource(fragmentPath);
 
@@ -32,8 +34,27 @@ std::string Shader::loadSource(const std::string &path) {
         return std::string();
     }
 
+    // Resolve #include "file" lines relative to this file, so shaders can share GLSL snippets
+    std::string directory;
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        directory = path.substr(0, slash + 1);
+    }
+
     std::stringstream buffer;
-    buffer << file.rdbuf();
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t start = line.find("#include");
+        if (start != std::string::npos && line.find_first_not_of(" \t") == start) {
+            size_t open = line.find('"', start);
+            size_t close = line.find('"', open + 1);
+            if (open != std::string::npos && close != std::string::npos) {
+                buffer << loadSource(directory + line.substr(open + 1, close - open - 1));
+                continue;
+            }
+        }
+        buffer << line << '\n';
+    }
     return buffer.str();
 }
 
@@ -81,6 +102,16 @@ void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
     glUniformMatrix4fv(loc, 1, GL_FALSE, &mat[0][0]);
 }
 
+void Shader::setVec2(const std::string &name, const glm::vec2 &vec) const {
+    GLint loc = glGetUniformLocation(ID, name.c_str());
+    glUniform2fv(loc, 1, &vec[0]);
+}
+
+void Shader::setIVec3(const std::string &name, int x, int y, int z) const {
+    GLint loc = glGetUniformLocation(ID, name.c_str());
+    glUniform3i(loc, x, y, z);
+}
+
 void Shader::setVec3(const std::string &name, const glm::vec3 &vec) const {
     GLint loc = glGetUniformLocation(ID, name.c_str());
     glUniform3fv(loc, 1, &vec[0]);
@@ -0,0 +1,261 @@
+#include "ShadowAtlas.h"
+#include <algorithm>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Cube face order +X, -X, +Y, -Y, +Z, -Z. shaders/point_shadows.glsl uses the same table.
+static const glm::vec3 FACE_FORWARD[6] = {
+    { 1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f},
+    { 0.0f,-1.0f, 0.0f}, { 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f,-1.0f}
+};
+static const glm::vec3 FACE_UP[6] = {
+    {0.0f,-1.0f, 0.0f}, {0.0f,-1.0f, 0.0f}, {0.0f, 0.0f, 1.0f},
+    {0.0f, 0.0f,-1.0f}, {0.0f,-1.0f, 0.0f}, {0.0f,-1.0f, 0.0f}
+};
+static const float SHADOW_NEAR = 0.02f;
+
+ShadowAtlas::ShadowAtlas(int atlasSize, const std::vector<ShadowTier> &tiers, int maxFaceUpdates)
+: tiers(tiers), atlasSize(atlasSize), maxFaceUpdates(maxFaceUpdates), facesRendered(0), moveTolerance(1e-4f),
+  depthShader("shaders/shadow_depth.vert", "shaders/shadow_depth.frag")
+{
+    // Shelf-pack the 3x2 face blocks, largest tier first
+    int x = 0, y = 0, rowHeight = 0;
+    for (int t = 0; t < (int)tiers.size(); t++) {
+        int blockWidth = tiers[t].tileSize * 3;
+        int blockHeight = tiers[t].tileSize * 2;
+        for (int i = 0; i < tiers[t].slotCount; i++) {
+            if (x + blockWidth > atlasSize) {
+                x = 0;
+                y += rowHeight;
+                rowHeight = 0;
+            }
+            if (y + blockHeight > atlasSize) {
+                std::cerr << "Shadow atlas too small, tier " << t << " gets " << i << " slots" << std::endl;
+                this->tiers[t].slotCount = i;
+                break;
+            }
+            Slot slot;
+            slot.x = x;
+            slot.y = y;
+            slot.tier = t;
+            slots.push_back(slot);
+            x += blockWidth;
+            rowHeight = std::max(rowHeight, blockHeight);
+        }
+    }
+
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, atlasSize, atlasSize, 0,
+                 GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    // Hardware depth compare gives us bilinear PCF for free
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Shadow atlas framebuffer is incomplete" << std::endl;
+    }
+    glClearDepth(1.0);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(1, &slotBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, slotBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    glGenTextures(1, &slotTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, slotTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, slotBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+ShadowAtlas::~ShadowAtlas() {
+    glDeleteTextures(1, &slotTexture);
+    glDeleteBuffers(1, &slotBuffer);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &depthTexture);
+}
+
+void ShadowAtlas::invalidate() {
+    for (Slot &slot : slots) {
+        slot.light = -1;
+        slot.valid = false;
+    }
+}
+
+void ShadowAtlas::update(const std::vector<PointLight> &lights, const glm::vec3 &viewPos,
+                         const std::vector<glm::vec4> &changedCasters) {
+    this->lights = lights;
+    int n = (int)lights.size();
+
+    std::vector<float> distance(n);
+    rankedLights.clear();
+    for (int i = 0; i < n; i++) {
+        distance[i] = glm::length(lights[i].position - viewPos);
+        if (distance[i] <= tiers.back().maxDistance) {
+            rankedLights.push_back(i);
+        }
+    }
+    std::sort(rankedLights.begin(), rankedLights.end(),
+              [&](int a, int b) { return distance[a] < distance[b]; });
+
+    // Nearest lights get the largest tier they qualify for, spilling into smaller tiers when full
+    std::vector<int> wantedTier(n, -1);
+    std::vector<int> used(tiers.size(), 0);
+    int tierCount = (int)tiers.size();
+    for (int light : rankedLights) {
+        int t = 0;
+        while (t < tierCount && distance[light] > tiers[t].maxDistance) t++;
+        while (t < tierCount && used[t] == tiers[t].slotCount) t++;
+        if (t < tierCount) {
+            wantedTier[light] = t;
+            used[t]++;
+        }
+    }
+
+    // Keep slots whose light stays in the same tier, release the rest
+    lightSlot.assign(n, -1);
+    for (int s = 0; s < (int)slots.size(); s++) {
+        Slot &slot = slots[s];
+        if (slot.light < 0) {
+            continue;
+        }
+        if (slot.light >= n || wantedTier[slot.light] != slot.tier) {
+            slot.light = -1;
+            slot.valid = false;
+        } else {
+            lightSlot[slot.light] = s;
+        }
+    }
+    for (int light : rankedLights) {
+        if (wantedTier[light] < 0 || lightSlot[light] >= 0) {
+            continue;
+        }
+        for (int s = 0; s < (int)slots.size(); s++) {
+            if (slots[s].light < 0 && slots[s].tier == wantedTier[light]) {
+                slots[s].light = light;
+                slots[s].valid = false;
+                lightSlot[light] = s;
+                break;
+            }
+        }
+    }
+
+    // A cached map is stale once its light moved or a caster moved inside the light's range
+    for (Slot &slot : slots) {
+        if (slot.light < 0 || !slot.valid) {
+            continue;
+        }
+        const PointLight &light = lights[slot.light];
+        if (glm::length(light.position - slot.position) > moveTolerance || light.radius != slot.radius) {
+            slot.valid = false;
+            continue;
+        }
+        for (const glm::vec4 &caster : changedCasters) {
+            if (glm::length(glm::vec3(caster) - light.position) < caster.w + light.radius) {
+                slot.valid = false;
+                break;
+            }
+        }
+    }
+}
+
+void ShadowAtlas::render(const std::function<void(const Shader &, const PointLight &)> &drawCasters) {
+    facesRendered = 0;
+    GLint viewport[4];
+    GLint framebuffer;
+    bool bound = false;
+
+    for (int light : rankedLights) {
+        int s = lightSlot[light];
+        if (s < 0 || slots[s].valid) {
+            continue;
+        }
+        if (facesRendered + 6 > maxFaceUpdates) {
+            break; // the rest waits for the next frame
+        }
+        if (!bound) {
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+            glEnable(GL_SCISSOR_TEST);
+            depthShader.use();
+            bound = true;
+        }
+
+        Slot &slot = slots[s];
+        const PointLight &pointLight = lights[light];
+        int tile = tiers[slot.tier].tileSize;
+        glScissor(slot.x, slot.y, tile * 3, tile * 2);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        glm::mat4 proj = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR, pointLight.radius);
+        depthShader.setVec3("uLightPos", pointLight.position);
+        depthShader.setFloat("uLightRadius", pointLight.radius);
+        for (int face = 0; face < 6; face++) {
+            glViewport(slot.x + (face % 3) * tile, slot.y + (face / 3) * tile, tile, tile);
+            glm::mat4 view = glm::lookAt(pointLight.position, pointLight.position + FACE_FORWARD[face], FACE_UP[face]);
+            depthShader.setMat4("uViewProjection", proj * view);
+            drawCasters(depthShader, pointLight);
+        }
+
+        slot.valid = true;
+        slot.position = pointLight.position;
+        slot.radius = pointLight.radius;
+        facesRendered += 6;
+    }
+
+    if (bound) {
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    // Only maps that are actually drawn go into the table
+    int n = (int)lights.size();
+    slotTable.assign((size_t)std::max(n, 1) * 4, 0.0f);
+    for (int i = 0; i < n; i++) {
+        int s = lightSlot[i];
+        if (s >= 0 && slots[s].valid) {
+            slotTable[i*4 + 0] = (float)slots[s].x;
+            slotTable[i*4 + 1] = (float)slots[s].y;
+            slotTable[i*4 + 2] = (float)tiers[slots[s].tier].tileSize;
+        }
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, slotBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, slotTable.size() * sizeof(float), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, slotTable.size() * sizeof(float), slotTable.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ShadowAtlas::bind(const Shader &shader, int firstUnit) const {
+    glActiveTexture(GL_TEXTURE0 + firstUnit);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+    glBindTexture(GL_TEXTURE_BUFFER, slotTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setInt("uShadowAtlas", firstUnit);
+    shader.setInt("uShadowSlots", firstUnit + 1);
+    shader.setFloat("uShadowAtlasSize", (float)atlasSize);
+}
+
+int ShadowAtlas::getShadowedLightCount() const {
+    int count = 0;
+    for (const Slot &slot : slots) {
+        if (slot.light >= 0 && slot.valid) {
+            count++;
+        }
+    }
+    return count;
+}
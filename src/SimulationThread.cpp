@@ -0,0 +1,55 @@
+#include "SimulationThread.h"
+#include "Profiler.h"
+#include <chrono>
+
+// At most this many steps back to back when behind, beyond that time is dropped
+static const int MAX_CATCH_UP_STEPS = 4;
+
+SimulationThread::SimulationThread(double rateHz, std::function<void(float dt)> step)
+: rateHz(rateHz > 0.0 ? rateHz : 120.0), step(std::move(step)), stopping(false), skippedSteps(0) {}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start() {
+    if (thread.joinable()) {
+        return;
+    }
+    stopping.store(false);
+    thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+    stopping.store(true);
+    thread.join();
+}
+
+void SimulationThread::run() {
+    profilerSetThreadName("simulation");
+    using Clock = std::chrono::steady_clock;
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rateHz));
+    float dt = (float)(1.0 / rateHz);
+
+    // Fixed steps on a fixed cadence: the simulation behaves the same at any render rate
+    auto next = Clock::now();
+    while (!stopping.load(std::memory_order_relaxed)) {
+        int steps = 0;
+        while (Clock::now() >= next && steps < MAX_CATCH_UP_STEPS) {
+            step(dt);
+            next += period;
+            steps++;
+        }
+        auto now = Clock::now();
+        if (now >= next) {
+            // Still behind after catching up (debugger, heavy hitch): drop the backlog
+            long long dropped = (long long)((now - next) / period) + 1;
+            skippedSteps.fetch_add(dropped, std::memory_order_relaxed);
+            next += period * dropped;
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
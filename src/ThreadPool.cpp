@@ -0,0 +1,94 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount)
+: stopping(false), generation(0), job(nullptr), jobCount(0), jobGrain(1), nextChunk(0), chunkCount(0), activeWorkers(0)
+{
+    if (threadCount <= 0) {
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    }
+    for (int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::runChunks() {
+    for (;;) {
+        int chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= chunkCount) {
+            break;
+        }
+        int begin = chunk * jobGrain;
+        int end = std::min(begin + jobGrain, jobCount);
+        (*job)(begin, end);
+    }
+}
+
+void ThreadPool::workerLoop(int index) {
+    profilerSetThreadName("worker " + std::to_string(index));
+    unsigned long long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        {
+            PROFILE_SCOPE("ThreadPool::job");
+            runChunks();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--activeWorkers == 0) {
+            done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)> &fn) {
+    if (count <= 0) {
+        return;
+    }
+    grain = std::max(grain, 1);
+    int chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || workers.empty()) {
+        fn(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        jobGrain = grain;
+        chunkCount = chunks;
+        nextChunk.store(0, std::memory_order_relaxed);
+        activeWorkers = (int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    runChunks();
+
+    // Workers hold a pointer to fn, so wait for all of them, not just for the chunks
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return activeWorkers == 0; });
+    job = nullptr;
+}
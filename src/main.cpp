@@ -1,18 +1,53 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "BufferArena.h"
+#include "DeferredRenderer.h"
+#include "DynamicResolution.h"
+#include "EmitterManager.h"
+#include "FlameFluid.h"
+#include "FlameLight.h"
+#include "FlameVolume.h"
+#include "FramePacer.h"
+#include "GpuTimer.h"
+#include "InputRecorder.h"
+#include "LightClusters.h"
 #include "Shader.h"
 #include "CandleModel.h"
+#include "CurlNoise.h"
 #include "RoomModel.h"
+#include "SceneIndex.h"
+#include "ParticleCompositor.h"
 #include "ParticleEmitter.h"
+#include "ParticleSort.h"
+#include "PostProcess.h"
+#include "Profiler.h"
+#include "ShadowAtlas.h"
+#include "SimulationThread.h"
+#include "ThreadPool.h"
+#include "TripleBuffer.h"
+
+static int windowWidth = 800;
+static int windowHeight = 600;
 
 static void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0,0,width,height);
+    windowWidth = width;
+    windowHeight = height;
 }
 
-static glm::vec3 cameraPos(0.0f,0.0f,3.0f);
 static glm::vec3 cameraFront(0.0f,0.0f,-4.0f);
 static glm::vec3 cameraUp(0.0f,1.0f,0.0f);
 
@@ -20,8 +55,218 @@ float moveSpeed = 2.0f;
 const float ROOM_MIN = -5.0f;
 const float ROOM_MAX =  5.0f;
 
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+
+// Floating candles spread over the room, each with its own flame and light
+const int FLOATING_CANDLES_PER_SIDE = 6;
+const float FLOATING_CANDLE_HEIGHT = -1.0f;
+const float CANDLE_LIGHT_RADIUS = 4.0f;
+const glm::vec3 FLAME_LIGHT_COLOR(2.0f, 1.0f, 0.5f); // warm flame color
+const glm::vec3 FLAME_OFFSET(0.0f, 0.3f, 0.0f);     // candle center -> flame
+const float CANDLE_SCALE = 0.5f;                    // Increase scale if candle too small
+const float CANDLE_BOUND_RADIUS = 0.3f;             // bounding sphere of a scaled candle, wick included
+const float CORE_EMISSION_RATE = 300.0f;            // particles per second
+const float HAZE_EMISSION_RATE = 100.0f;
+const float FLAME_BOUND_RADIUS = 0.25f;             // how far flame and haze particles drift sideways
+const float FLAME_BOUND_HEIGHT = 2.1f;              // and how high the haze rises before it dies
+const float TURBULENCE_STRENGTH = 0.15f;            // curl noise drift, units per second
+const float TURBULENCE_SCALE = 0.5f;                // noise tiles per unit, one tile spans 2 units
+const float SIMULATION_FOV_MARGIN = 10.0f;          // degrees, candles about to come into view keep simulating
+const float SHADOW_MOVE_TOLERANCE = 0.2f;           // flicker moves lights less than this, their shadow maps stay cached
+const int SIMULATION_WORKERS = 2;                   // the simulation thread's own pool, besides itself
+const int MAX_FLUID_STEPS = 8;                      // fluid grids stepped per simulation step, the rest wait their turn
+
+struct SceneCandle {
+    glm::vec3 position;
+    std::unique_ptr<ParticleEmitter> coreFlame;
+    std::unique_ptr<ParticleEmitter> haze;
+    int sceneObject = -1;
+};
+
+// Everything the renderer needs from one simulation step. The simulation thread fills one
+// while the renderer reads another (TripleBuffer), so neither waits for the other.
+struct FrameSnapshot {
+    glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
+    glm::vec3 candlePos = glm::vec3(0.0f);
+    std::vector<PointLight> lights;
+    std::vector<std::vector<float>> particlePositions; // per emitter, same order as the emitter list
+    int liveParticles = 0;
+    float particleBudgetScale = 1.0f;
+    bool fluidFlames = false;
+    std::vector<std::vector<uint8_t>> flameVolumes; // per candle, held one first; empty when not simulated
+    std::vector<long long> flameVolumeVersions;     // per candle, bumped whenever its grid stepped
+    long long step = 0;
+};
+
+// Movement keys and the flame mode, sampled on the main thread (GLFW input is main thread only)
+// for the simulation. Everything that changes the simulation goes through here, so the input
+// log holds it.
+enum InputKey { INPUT_UP = 1, INPUT_DOWN = 2, INPUT_LEFT = 4, INPUT_RIGHT = 8, INPUT_FLUID_FLAMES = 16 };
+static std::atomic<unsigned> inputKeys(0);
+
+enum class RenderPath { Forward, Deferred };
+static const char *RENDER_PATH_NAMES[] = { "forward", "deferred" };
+static RenderPath renderPath = RenderPath::Forward;
+static bool lightmapEnabled = true;
+static bool printGpuTimings = false;
+static bool halfResParticles = true;
+static bool sortedParticles = false;
+static bool fluidFlames = false;     // sent to the simulation as INPUT_FLUID_FLAMES
+static bool replayingInput = false;  // the flame mode then comes from the log
+static bool dynamicResolution = true;
+static bool writeTraceRequested = false;
+static bool cycleVsyncRequested = false;
+static const char *VSYNC_NAMES[] = { "off", "on", "adaptive" };
+
+static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    // F1 switches between forward and deferred shading
+    if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
+        renderPath = renderPath == RenderPath::Forward ? RenderPath::Deferred : RenderPath::Forward;
+        std::cout << "Render path: " << RENDER_PATH_NAMES[(int)renderPath] << std::endl;
+    }
+    // F2 switches the baked room lighting off, all lights are then fully evaluated per pixel
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS) {
+        lightmapEnabled = !lightmapEnabled;
+        std::cout << "Lightmap: " << (lightmapEnabled ? "on" : "off") << std::endl;
+    }
+    // F3 prints the GPU time of every pass
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+        printGpuTimings = true;
+    }
+    // F4 switches the particles between half and full resolution
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS) {
+        halfResParticles = !halfResParticles;
+        std::cout << "Particles: " << (halfResParticles ? "half" : "full") << " resolution" << std::endl;
+    }
+    // F5 switches dynamic resolution, off renders at the window size
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS) {
+        dynamicResolution = !dynamicResolution;
+        std::cout << "Dynamic resolution: " << (dynamicResolution ? "on" : "off") << std::endl;
+    }
+    // F6 writes the CPU profile (needs a -DCANDLE_PROFILE build)
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS) {
+        writeTraceRequested = true;
+    }
+    // F7 cycles vsync off / on / adaptive
+    if (key == GLFW_KEY_F7 && action == GLFW_PRESS) {
+        cycleVsyncRequested = true;
+    }
+    // F8 switches the particles between additive and depth sorted alpha blending
+    if (key == GLFW_KEY_F8 && action == GLFW_PRESS) {
+        sortedParticles = !sortedParticles;
+        std::cout << "Particles: " << (sortedParticles ? "sorted alpha" : "additive") << " blending" << std::endl;
+    }
+    // F9 switches the flames between particles and the ray-marched fluid grids
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+        if (replayingInput) {
+            std::cout << "Flames: set by the replayed input log" << std::endl;
+        } else {
+            fluidFlames = !fluidFlames;
+            std::cout << "Flames: " << (fluidFlames ? "fluid grids" : "particles") << std::endl;
+        }
+    }
+}
+
+// Command line:
+//   --deferred     start on the deferred path
+//   --bench N      headless benchmark: hidden window, fixed time step, N frames per render path
+//                  (at the full window resolution unless --target-ms is given)
+//   --target-ms T  frame time budget of the dynamic resolution, default 60 fps
+//   --csv FILE     GPU pass timings of every frame, written by the benchmark (default bench_gpu.csv)
+//   --trace FILE   Chrome trace of the CPU profile, written on exit (-DCANDLE_PROFILE builds)
+//   --fps N        frame limiter target, 0 (default) leaves pacing to vsync
+//   --vsync MODE   off, on or adaptive (default, falls back to on without swap control tear)
+//   --sim-hz N     simulation rate of the simulation thread, default 120
+//   --particles N  live particle budget over all emitters, default 12000
+//   --sorted       start with depth sorted alpha blended particles
+//   --fluid        start with the fluid grid flames instead of particles
+//   --flame-budget N  ray samples per frame for the fluid flames, in millions, default 8
+//   --record FILE  write the input of every simulation step (dt, movement keys, flame mode) to FILE
+//   --replay FILE  drive the simulation from a recorded log instead of the keyboard, one step
+//                  per frame on the main thread, at the full window resolution unless --target-ms
+//                  is given; the window closes at the end of the log (a benchmark keeps going
+//                  with no keys held)
+struct Options {
+    RenderPath path = RenderPath::Forward;
+    int benchFrames = 0;
+    float targetMs = 0.0f;
+    std::string csvPath = "bench_gpu.csv";
+    std::string tracePath;
+    FramePacerSettings pacing;
+    double simHz = 120.0;
+    EmitterLodSettings particleLod;
+    bool sortedParticles = false;
+    bool fluidFlames = false;
+    FlameVolumeSettings flameVolume;
+    std::string recordPath;
+    std::string replayPath;
+};
+
+static Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--deferred") == 0) {
+            options.path = RenderPath::Deferred;
+        } else if (std::strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            options.benchFrames = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--target-ms") == 0 && i + 1 < argc) {
+            options.targetMs = std::max(1.0f, (float)std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            options.csvPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.tracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            options.pacing.targetFps = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--sim-hz") == 0 && i + 1 < argc) {
+            options.simHz = std::max(1.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--sorted") == 0) {
+            options.sortedParticles = true;
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            options.recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            options.replayPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--fluid") == 0) {
+            options.fluidFlames = true;
+        } else if (std::strcmp(argv[i], "--flame-budget") == 0 && i + 1 < argc) {
+            options.flameVolume.sampleBudget = std::max(0.1f, (float)std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+            options.particleLod.particleBudget = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--vsync") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (std::strcmp(mode, "off") == 0) {
+                options.pacing.vsync = VsyncMode::Off;
+            } else if (std::strcmp(mode, "on") == 0) {
+                options.pacing.vsync = VsyncMode::On;
+            } else if (std::strcmp(mode, "adaptive") == 0) {
+                options.pacing.vsync = VsyncMode::Adaptive;
+            } else {
+                std::cerr << "Unknown vsync mode: " << mode << std::endl;
+            }
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+        }
+    }
+    return options;
+}
+
+// Wall time per frame, with glFinish so the GPU work is included
+struct BenchResult {
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    int frames = 0;
+};
+
+
+int main(int argc, char** argv) {
+    Options options = parseOptions(argc, argv);
+    profilerSetThreadName("main");
+    bool benchmark = options.benchFrames > 0;
+    renderPath = options.path;
+    if ((benchmark || !options.replayPath.empty()) && options.targetMs <= 0.0f) {
+        dynamicResolution = false; // compare the paths (or replays) at the same resolution
+    }
 
-int main() {
     if(!glfwInit()){
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return -1;
@@ -30,6 +275,9 @@ int main() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
     glfwWindowHint(GLFW_OPENGL_PROFILE,GLFW_OPENGL_CORE_PROFILE);
+    if (benchmark) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 
     GLFWwindow* window = glfwCreateWindow(800,600,"Debug Candle and Particles",NULL,NULL);
     if(!window){
@@ -45,6 +293,14 @@ int main() {
     }
 
     glfwSetFramebufferSizeCallback(window,framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+    // Measure the renderer, not the display
+    if (benchmark) {
+        options.pacing.vsync = VsyncMode::Off;
+        options.pacing.targetFps = 0.0;
+    }
+    FramePacer framePacer(options.pacing);
+    std::cout << "Vsync: " << VSYNC_NAMES[(int)framePacer.applyVsync()] << std::endl;
     glEnable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE); // Make sure we can see inside the room
 
@@ -56,138 +312,808 @@ int main() {
     Shader roomShader("shaders/room.vert","shaders/room.frag");
     Shader candleShader("shaders/candle.vert","shaders/candle.frag");
     Shader particleShader("shaders/particle.vert","shaders/particle.frag");
+    DeferredRenderer deferred(windowWidth, windowHeight);
+    PostProcess postProcess(windowWidth, windowHeight);
+    ParticleCompositor particleCompositor(windowWidth, windowHeight);
+    DynamicResolutionSettings resolutionSettings;
+    if (options.targetMs > 0.0f) {
+        resolutionSettings.targetMs = options.targetMs;
+    }
+    DynamicResolution resolution(resolutionSettings);
+    GpuTimer gpuTimer;
+    std::ofstream gpuCsv;
+    if (benchmark) {
+        gpuCsv.open(options.csvPath);
+        if (gpuCsv.is_open()) {
+            gpuTimer.setCsvOutput(&gpuCsv);
+        } else {
+            std::cerr << "Failed to open " << options.csvPath << std::endl;
+        }
+    }
 
-    RoomModel room;
-    CandleModel candle;
-    ParticleEmitter coreFlameEmitter(500, EmitterType::CoreFlame);
-    ParticleEmitter hazeEmitter(300, EmitterType::HeatHaze);
+    // All static meshes and particle streams live in one set of shared buffers
+    BufferArena arena;
+    RoomModel room(arena);
+    CandleModel candle(arena);
+    ParticleEmitter coreFlameEmitter(arena, 500, EmitterType::CoreFlame);
+    ParticleEmitter hazeEmitter(arena, 300, EmitterType::HeatHaze);
 
-    glm::mat4 proj = glm::perspective(glm::radians(45.0f),(float)800/(float)600,0.1f,100.0f);
+    // Worker threads for per-frame parallel jobs (light binning)
+    ThreadPool threadPool;
+    LightClusters lightClusters(threadPool);
+    ShadowAtlas shadowAtlas;
+    shadowAtlas.setMoveTolerance(SHADOW_MOVE_TOLERANCE);
 
-    // Increase ambient light in the fragment shaders if too dark (done in shaders).
-    // Temporarily, you can hardcode colors in candle.frag and particle.frag to ensure visibility.
+    std::vector<SceneCandle> sceneCandles;
+    for (int i = 0; i < FLOATING_CANDLES_PER_SIDE; i++) {
+        for (int j = 0; j < FLOATING_CANDLES_PER_SIDE; j++) {
+            SceneCandle sceneCandle;
+            float spacing = (ROOM_MAX - ROOM_MIN - 2.0f) / (FLOATING_CANDLES_PER_SIDE - 1);
+            sceneCandle.position = glm::vec3(ROOM_MIN + 1.0f + i * spacing, FLOATING_CANDLE_HEIGHT,
+                                             ROOM_MIN + 1.0f + j * spacing);
+            sceneCandle.coreFlame.reset(new ParticleEmitter(arena, 500, EmitterType::CoreFlame));
+            sceneCandle.haze.reset(new ParticleEmitter(arena, 300, EmitterType::HeatHaze));
+            sceneCandle.coreFlame->setEmissionPosition(sceneCandle.position + FLAME_OFFSET);
+            sceneCandle.haze->setEmissionPosition(sceneCandle.position + FLAME_OFFSET);
+            sceneCandles.push_back(std::move(sceneCandle));
+        }
+    }
 
-    double lastTime = glfwGetTime();
-    int frameCount = 0;
-    float emissionRate = 300.0f;
+    // The floating candles never move: bake their light into the room once (cached on disk)
+    std::vector<PointLight> staticLights;
+    std::vector<LightmapBox> staticOccluders;
+    glm::vec3 candleExtent(candle.getParams().radius, candle.getParams().height * 0.5f, candle.getParams().radius);
+    candleExtent *= CANDLE_SCALE;
+    for (const SceneCandle &sceneCandle : sceneCandles) {
+        staticLights.push_back({sceneCandle.position + FLAME_OFFSET, CANDLE_LIGHT_RADIUS, FLAME_LIGHT_COLOR, 1.0f});
+        staticOccluders.push_back({sceneCandle.position - candleExtent, sceneCandle.position + candleExtent});
+    }
+    room.bakeLightmap(threadPool, staticLights, staticOccluders);
 
-    while(!glfwWindowShouldClose(window)) {
-        double currentTime = glfwGetTime();
-        float dt = (float)(currentTime - lastTime);
-        frameCount++;
-        //FPS Display Bug
-        if (currentTime - lastTime >= 1.0) { // One second has passed
-        std::cout << "FPS: " << frameCount << std::endl;
-        frameCount = 0;              // Reset the frame count
-           // Reset the timer
+    // Culling boxes: the candle plus the volume its flame and haze particles can reach
+    auto candleBounds = [&](const glm::vec3 &position) {
+        glm::vec3 flamePos = position + FLAME_OFFSET;
+        Aabb bounds;
+        bounds.min = glm::min(position - candleExtent, flamePos - glm::vec3(FLAME_BOUND_RADIUS, 0.0f, FLAME_BOUND_RADIUS));
+        bounds.max = glm::max(position + candleExtent, flamePos + glm::vec3(FLAME_BOUND_RADIUS, FLAME_BOUND_HEIGHT, FLAME_BOUND_RADIUS));
+        return bounds;
+    };
+    SceneIndex sceneIndex;
+    int heldCandleObject = sceneIndex.add(candleBounds(glm::vec3(0.0f)));
+    for (SceneCandle &sceneCandle : sceneCandles) {
+        sceneCandle.sceneObject = sceneIndex.add(candleBounds(sceneCandle.position));
+    }
+    std::vector<int> visibleObjects;
+    std::vector<unsigned char> objectVisible;
+
+    // Every emitter in a fixed order, the snapshot's particle lists follow it
+    std::vector<ParticleEmitter*> emitters = { &coreFlameEmitter, &hazeEmitter };
+    std::vector<int> emitterObjects = { heldCandleObject, heldCandleObject }; // scene object of each emitter
+    for (SceneCandle &sceneCandle : sceneCandles) {
+        emitters.push_back(sceneCandle.coreFlame.get());
+        emitters.push_back(sceneCandle.haze.get());
+        emitterObjects.push_back(sceneCandle.sceneObject);
+        emitterObjects.push_back(sceneCandle.sceneObject);
+    }
+    // Fixed seeds, so equal input gives equal particles run after run
+    for (size_t i = 0; i < emitters.size(); i++) {
+        emitters[i]->setSeed((uint32_t)i + 1);
+    }
+    // Coherent drift for every emitter from one precomputed curl noise field
+    CurlNoiseField curlNoise(threadPool);
+    for (ParticleEmitter *emitter : emitters) {
+        emitter->setTurbulence(&curlNoise, TURBULENCE_STRENGTH, TURBULENCE_SCALE);
     }
-        lastTime = currentTime;
-        
 
+    // Emission and updates follow each flame's size on screen, under one particle budget.
+    // Indices match the emitter list.
+    EmitterManager emitterManager(options.particleLod);
+    for (size_t i = 0; i < emitters.size(); i++) {
+        emitterManager.add(emitters[i], i % 2 == 0 ? CORE_EMISSION_RATE : HAZE_EMISSION_RATE);
+    }
 
-        glm::vec3 proposedPos = cameraPos;
-        if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+    // Light flicker from each flame's core emitter, held candle first
+    std::vector<FlameLight> flameLights(sceneCandles.size() + 1);
+
+    // Sorted alpha blending draws every visible particle from one stream, back to front
+    sortedParticles = options.sortedParticles;
+    ParticleSorter particleSorter(threadPool);
+    size_t particleCapacity = 0;
+    for (ParticleEmitter *emitter : emitters) {
+        particleCapacity += emitter->getMaxParticles();
+    }
+    ArenaStream sortedStream = arena.allocateStream(ParticleEmitter::vertexLayout(), particleCapacity);
+    std::vector<float> unsortedPositions, sortedPositions;
+
+    // The alternative flames: a fluid grid per wick (held candle first), ray-marched from 3D
+    // textures. The particles keep simulating underneath, only their drawing stops.
+    fluidFlames = options.fluidFlames;
+    inputKeys.store(fluidFlames ? INPUT_FLUID_FLAMES : 0); // for the first step, before any frame
+    FluidSettings fluidSettings;
+    std::vector<FlameFluid> flameFluids;
+    for (size_t i = 0; i <= sceneCandles.size(); i++) {
+        fluidSettings.seed = (uint32_t)i + 1; // every flame flickers its own way
+        flameFluids.emplace_back(fluidSettings);
+    }
+    std::vector<int> steppedFluids;
+    // Not every grid steps every simulation step: at most MAX_FLUID_STEPS, taken round robin.
+    // A grid then catches up on the time it waited, and its last texels stay on show meanwhile.
+    std::vector<float> fluidPendingTime(flameFluids.size(), 0.0f);
+    std::vector<std::vector<uint8_t>> fluidTexels(flameFluids.size());
+    std::vector<long long> fluidVersions(flameFluids.size(), 0);
+    size_t nextFluid = 0;
+    // The grids step on a pool of their own. parallelFor takes one job at a time, and sharing
+    // the render thread's pool would make light binning and sorting wait for the fluids.
+    ThreadPool simulationPool(SIMULATION_WORKERS);
+    FlameVolumeRenderer flameVolumes(arena, (int)flameFluids.size(), fluidSettings.sizeX, fluidSettings.sizeY,
+                                     fluidSettings.sizeZ, options.flameVolume);
+    glm::vec3 fluidBoxSize = flameFluids[0].getWorldSize();
+    glm::vec3 fluidSourceOffset = flameFluids[0].getSourceOffset();
+    std::vector<long long> uploadedVolumeVersions(flameFluids.size(), -1);
+
+    // Simulation: camera, emitters and lights. Once the thread runs it owns the camera state
+    // and the emitters' particles; the renderer only sees the published snapshots.
+    TripleBuffer<FrameSnapshot> snapshots;
+    // The renderer sends back the projected size of every scene object in (or close to) view,
+    // indexed by object id, 0 when out of view. It drives the emitters' level of detail.
+    TripleBuffer<std::vector<float>> objectScreenSizes;
+    glm::vec3 simCameraPos = FrameSnapshot().cameraPos;
+    long long simStep = 0;
+    unsigned replayedKeys = 0;
+    // Input logs work on simulation steps: a recording keeps what each step consumed, a replay
+    // hands exactly that back. With the seeded emitters and grids, a replay is bit-identical
+    // run after run.
+    InputRecorder inputRecorder;
+    InputPlayer inputPlayer;
+    if (!options.recordPath.empty()) {
+        inputRecorder.open(options.recordPath);
+    }
+    if (!options.replayPath.empty() && inputPlayer.open(options.replayPath)) {
+        std::cout << "Replaying " << inputPlayer.getStepCount() << " steps from " << options.replayPath << std::endl;
+    }
+    auto finishRecording = [&]() {
+        if (inputRecorder.isOpen()) {
+            uint64_t steps = inputRecorder.getStepCount();
+            inputRecorder.close();
+            std::cout << "Input of " << steps << " steps written to " << options.recordPath << std::endl;
+        }
+    };
+    auto simulate = [&](float dt) {
+        PROFILE_SCOPE("simulate");
+        unsigned keys = inputKeys.load(std::memory_order_relaxed);
+        if (inputPlayer.isOpen()) {
+            // Past the end of the log no keys are held, the flames stay as the log left them
+            InputStep recorded;
+            keys = replayedKeys & INPUT_FLUID_FLAMES;
+            if (inputPlayer.next(recorded)) {
+                dt = recorded.dt;
+                keys = recorded.keys;
+            }
+            replayedKeys = keys;
+        }
+        if (inputRecorder.isOpen()) {
+            InputStep step;
+            step.dt = dt;
+            step.keys = keys;
+            inputRecorder.record(step);
+        }
+        glm::vec3 proposedPos = simCameraPos;
+        if (keys & INPUT_UP) {
             proposedPos += cameraFront * moveSpeed * dt;
         }
-        if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+        if (keys & INPUT_DOWN) {
             proposedPos -= cameraFront * moveSpeed * dt;
         }
 
         glm::vec3 right = glm::normalize(glm::cross(cameraFront, cameraUp));
-        if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
+        if (keys & INPUT_LEFT) {
             proposedPos -= right * moveSpeed * dt;
         }
-        if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
+        if (keys & INPUT_RIGHT) {
             proposedPos += right * moveSpeed * dt;
         }
 
         // Clamp camera inside room
         proposedPos.x = glm::clamp(proposedPos.x, ROOM_MIN+0.5f, ROOM_MAX-0.5f);
         proposedPos.z = glm::clamp(proposedPos.z, ROOM_MIN+0.5f, ROOM_MAX-0.5f);
-        cameraPos = proposedPos;
+        simCameraPos = proposedPos;
 
         // Candle in front of camera
-        glm::vec3 candlePos = cameraPos + cameraFront * 0.5f + glm::vec3(0.0f,-0.4f,0.0f);
-        
-        
-        glm::vec3 flamePos = candlePos + glm::vec3(0.0f,0.3f,0.0f);
+        glm::vec3 candlePos = simCameraPos + cameraFront * 0.5f + glm::vec3(0.0f,-0.4f,0.0f);
+        glm::vec3 flamePos = candlePos + FLAME_OFFSET;
         coreFlameEmitter.setEmissionPosition(flamePos);
         hazeEmitter.setEmissionPosition(flamePos);
-        // Update particles
 
-        int coreCount = (int)(300 * dt);   // rate for core flame
-        int hazeCount = (int)(100 * dt);   // rate for haze
+        // Update particles. Until the renderer has culled a first frame every emitter counts
+        // as fully visible.
+        objectScreenSizes.update();
+        const std::vector<float> &screenSizes = objectScreenSizes.readBuffer();
+        if (!screenSizes.empty()) {
+            for (size_t i = 0; i < emitters.size(); i++) {
+                emitterManager.setScreenSize((int)i, screenSizes[emitterObjects[i]]);
+            }
+        }
+        emitterManager.update(dt);
+        flameLights[0].update(coreFlameEmitter.getStats(), flamePos, dt);
+        for (size_t i = 0; i < sceneCandles.size(); i++) {
+            flameLights[i + 1].update(sceneCandles[i].coreFlame->getStats(), sceneCandles[i].position + FLAME_OFFSET, dt);
+        }
+
+        FrameSnapshot &snapshot = snapshots.writeBuffer();
+        snapshot.cameraPos = simCameraPos;
+        snapshot.candlePos = candlePos;
+
+        // One flickering light per flame
+        snapshot.lights.clear();
+        for (size_t i = 0; i < flameLights.size(); i++) {
+            const FlameLight &flameLight = flameLights[i];
+            // The floating candles are baked at full intensity, the room shaders only add the difference
+            float baked = i == 0 ? 0.0f : 1.0f;
+            snapshot.lights.push_back({flameLight.getPosition(), CANDLE_LIGHT_RADIUS,
+                                       flameLight.getColor(FLAME_LIGHT_COLOR), flameLight.getIntensity(), baked});
+        }
+
+        snapshot.particlePositions.resize(emitters.size());
+        for (size_t i = 0; i < emitters.size(); i++) {
+            if (emitterManager.isVisible((int)i)) {
+                emitters[i]->writePositions(snapshot.particlePositions[i]);
+            } else {
+                snapshot.particlePositions[i].clear();
+            }
+        }
+        snapshot.liveParticles = emitterManager.getLiveParticles();
+        snapshot.particleBudgetScale = emitterManager.getBudgetScale();
+
+        // Fluid flames of the candles in (or close to) view, the core emitter's visibility
+        // stands for its candle. Many small grids: one job per grid rather than slabs.
+        snapshot.fluidFlames = (keys & INPUT_FLUID_FLAMES) != 0;
+        size_t fluidCount = flameFluids.size();
+        auto fluidSimulated = [&](size_t i) {
+            return snapshot.fluidFlames && emitterManager.isVisible((int)i * 2);
+        };
+        steppedFluids.clear();
+        for (size_t k = 0; k < fluidCount; k++) {
+            size_t i = (nextFluid + k) % fluidCount;
+            if (!fluidSimulated(i)) {
+                fluidPendingTime[i] = 0.0f; // out of view grids pause
+                continue;
+            }
+            fluidPendingTime[i] += dt;
+            if ((int)steppedFluids.size() < MAX_FLUID_STEPS) {
+                steppedFluids.push_back((int)i);
+            }
+        }
+        if (!steppedFluids.empty()) {
+            nextFluid = (steppedFluids.back() + 1) % fluidCount;
+            simulationPool.parallelFor((int)steppedFluids.size(), 1, [&](int begin, int end) {
+                for (int k = begin; k < end; k++) {
+                    int i = steppedFluids[k];
+                    flameFluids[i].step(fluidPendingTime[i]);
+                    fluidPendingTime[i] = 0.0f;
+                    flameFluids[i].writeVolume(fluidTexels[i]);
+                    fluidVersions[i]++;
+                }
+            });
+        }
+        // Every simulated grid goes into the snapshot, stepped or not: the renderer may skip
+        // snapshots, the versions tell it which textures are out of date
+        snapshot.flameVolumes.resize(fluidCount);
+        snapshot.flameVolumeVersions.resize(fluidCount);
+        for (size_t i = 0; i < fluidCount; i++) {
+            if (fluidSimulated(i)) {
+                snapshot.flameVolumes[i] = fluidTexels[i];
+            } else {
+                snapshot.flameVolumes[i].clear();
+            }
+            snapshot.flameVolumeVersions[i] = fluidVersions[i];
+        }
+        snapshot.step = ++simStep;
+        snapshots.publish();
+    };
+
+    // The benchmark and replays step the simulation inline, once per frame, so the frames do not
+    // depend on thread timing (a replay substitutes the recorded dt). Every benchmark path starts
+    // from the same state, a replay is played again for each. Otherwise the simulation runs on
+    // its own thread at a fixed rate.
+    bool replaying = inputPlayer.isOpen();
+    replayingInput = replaying;
+    bool inlineSimulation = benchmark || replaying;
+    SimulationThread simulation(options.simHz, simulate);
+    simulation.stepNow(0.0f); // first snapshot before the first frame
+    if (!inlineSimulation) {
+        simulation.start();
+    }
+
+    std::vector<glm::vec4> changedCasters;
+    glm::vec3 lastCandlePos(0.0f);
+
+    // The benchmark puts everything that evolves from frame to frame back to its start before
+    // each render path, so every path renders the same frames: simulation state, the replay
+    // position, the screen size feedback and the renderer's caches. A recording stops there,
+    // it holds the input of the first path.
+    auto restartBenchmarkPath = [&]() {
+        simCameraPos = FrameSnapshot().cameraPos;
+        simStep = 0;
+        replayedKeys = 0;
+        for (size_t i = 0; i < emitters.size(); i++) {
+            emitters[i]->restart((uint32_t)i + 1); // the seeds from startup
+        }
+        emitterManager.reset();
+        flameLights.assign(flameLights.size(), FlameLight());
+        for (FlameFluid &fluid : flameFluids) {
+            fluid.reset();
+        }
+        std::fill(fluidPendingTime.begin(), fluidPendingTime.end(), 0.0f);
+        std::fill(fluidVersions.begin(), fluidVersions.end(), 0);
+        for (std::vector<uint8_t> &texels : fluidTexels) {
+            texels.clear();
+        }
+        nextFluid = 0;
+        if (inputPlayer.isOpen()) {
+            inputPlayer.rewind();
+        }
+        finishRecording();
+        // No feedback yet, like before the first frame
+        objectScreenSizes.writeBuffer().clear();
+        objectScreenSizes.publish();
+        simulation.stepNow(0.0f);
+
+        std::fill(uploadedVolumeVersions.begin(), uploadedVolumeVersions.end(), -1);
+        shadowAtlas.invalidate();
+        lastCandlePos = glm::vec3(0.0f);
+        resolution.reset();
+    };
+
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f),(float)800/(float)600,NEAR_PLANE,FAR_PLANE);
+    // Wider view for the simulation's visibility, the feedback reaches it a step late
+    glm::mat4 simulationProj = glm::perspective(glm::radians(45.0f + SIMULATION_FOV_MARGIN),
+                                                (float)800/(float)600, NEAR_PLANE, FAR_PLANE);
 
-        coreFlameEmitter.emit(coreCount);
-        coreFlameEmitter.update(dt);
+    // Increase ambient light in the fragment shaders if too dark (done in shaders).
+    // Temporarily, you can hardcode colors in candle.frag and particle.frag to ensure visibility.
+
+    double fpsTime = glfwGetTime();
+    int frameCount = 0;
+    float emissionRate = 300.0f;
 
-        hazeEmitter.emit(hazeCount);
-        hazeEmitter.update(dt);
+    // The benchmark runs every render path over the same simulated frames, one after another,
+    // restarting the simulation in between (restartBenchmarkPath)
+    const int RENDER_PATH_COUNT = 2;
+    BenchResult benchResults[RENDER_PATH_COUNT];
+    int benchFrame = 0;
+    int lastFrameSamples = 0;
 
+    int traceCount = 0;
+
+    while(!glfwWindowShouldClose(window)) {
+        // Wait for the frame slot first and poll input after, so the input is as fresh as
+        // it can be when the frame is built
+        {
+            PROFILE_SCOPE("pacing");
+            framePacer.waitForNextFrame();
+        }
+        glfwPollEvents();
+        framePacer.markInput();
+        unsigned keys = 0;
+        keys |= glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS ? INPUT_UP : 0;
+        keys |= glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS ? INPUT_DOWN : 0;
+        keys |= glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS ? INPUT_LEFT : 0;
+        keys |= glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS ? INPUT_RIGHT : 0;
+        keys |= fluidFlames ? INPUT_FLUID_FLAMES : 0;
+        inputKeys.store(keys, std::memory_order_relaxed);
+        if (cycleVsyncRequested) {
+            cycleVsyncRequested = false;
+            VsyncMode &mode = framePacer.getSettings().vsync;
+            mode = (VsyncMode)(((int)mode + 1) % 3);
+            std::cout << "Vsync: " << VSYNC_NAMES[(int)framePacer.applyVsync()] << std::endl;
+        }
 
+        PROFILE_SCOPE("frame");
+        auto frameStart = std::chrono::steady_clock::now();
+        double currentTime = glfwGetTime();
+        if (benchmark) {
+            RenderPath path = (RenderPath)(benchFrame / options.benchFrames);
+            if (benchFrame > 0 && path != renderPath) {
+                restartBenchmarkPath();
+            }
+            renderPath = path;
+        }
+        if (inlineSimulation) {
+            simulation.stepNow(1.0f / 60.0f);
+            if (replaying && !benchmark && inputPlayer.isFinished()) {
+                std::cout << "Replay finished" << std::endl;
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
+            }
+        }
+        // FPS over one second windows
+        frameCount++;
+        if (!benchmark && currentTime - fpsTime >= 1.0) {
+            std::cout << "FPS: " << frameCount / (currentTime - fpsTime) << " ("
+                      << 1000.0 * (currentTime - fpsTime) / frameCount << " ms)" << std::endl;
+            frameCount = 0;
+            fpsTime = currentTime;
+        }
         
 
-        glClearColor(0.05f,0.05f,0.05f,1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // Newest simulation state, whatever step the simulation thread is at
+        snapshots.update();
+        const FrameSnapshot &frame = snapshots.readBuffer();
+        glm::vec3 cameraPos = frame.cameraPos;
+        glm::vec3 candlePos = frame.candlePos;
+        const std::vector<PointLight> &lights = frame.lights;
 
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
 
-        // Draw Room
-        roomShader.use();
+        // View culling. Candles out of view cost no draw calls here, and get only a trickle of
+        // particle simulation on the other thread.
+        {
+            PROFILE_SCOPE("culling");
+            sceneIndex.setBounds(heldCandleObject, candleBounds(candlePos));
+            visibleObjects.clear();
+            sceneIndex.cull(frustumFromMatrix(proj * view), visibleObjects);
+            objectVisible.assign(sceneIndex.getObjectCount(), 0);
+            for (int object : visibleObjects) {
+                objectVisible[object] = 1;
+            }
+
+            // Projected radius of the bounding sphere, at the output resolution so dynamic
+            // resolution changes do not move the particle detail around
+            std::vector<float> &screenSizes = objectScreenSizes.writeBuffer();
+            screenSizes.assign(sceneIndex.getObjectCount(), 0.0f);
+            visibleObjects.clear();
+            sceneIndex.cull(frustumFromMatrix(simulationProj * view), visibleObjects);
+            for (int object : visibleObjects) {
+                const Aabb &bounds = sceneIndex.getBounds(object);
+                float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+                float distance = glm::max(glm::length((bounds.min + bounds.max) * 0.5f - cameraPos), radius);
+                screenSizes[object] = radius * proj[1][1] * 0.5f * windowHeight / distance;
+            }
+            objectScreenSizes.publish();
+        }
+
+        // One light per flame, binned into the view's clusters
         {
+            PROFILE_SCOPE("light_binning");
+            lightClusters.update(lights, view, proj, NEAR_PLANE, FAR_PLANE);
+        }
+        // The scene renders at a fraction of the window size while the GPU is over budget
+        int renderWidth = dynamicResolution ? resolution.scaledSize(windowWidth) : windowWidth;
+        int renderHeight = dynamicResolution ? resolution.scaledSize(windowHeight) : windowHeight;
+        glm::vec2 screenSize((float)renderWidth, (float)renderHeight);
+
+        // Shadow maps are cached in the atlas. The held candle is the only caster that moves,
+        // so only the lights around it (and its own flame light) get redrawn.
+        changedCasters.clear();
+        if (glm::length(candlePos - lastCandlePos) > 1e-4f) {
+            changedCasters.push_back(glm::vec4(lastCandlePos, CANDLE_BOUND_RADIUS));
+            changedCasters.push_back(glm::vec4(candlePos, CANDLE_BOUND_RADIUS));
+            lastCandlePos = candlePos;
+        }
+        gpuTimer.beginFrame();
+        gpuTimer.begin("frame");
+        gpuTimer.begin("shadows");
+        {
+            PROFILE_SCOPE("shadows");
+            shadowAtlas.update(lights, cameraPos, changedCasters);
+            shadowAtlas.render([&](const Shader &shader, const PointLight &light) {
+                // The room is a convex box and cannot shadow itself, only the candles cast
+                int lod = candle.lodCount() - 1;
+                auto drawCaster = [&](const glm::vec3 &position) {
+                    if (glm::length(position - light.position) > light.radius + CANDLE_BOUND_RADIUS) {
+                        return;
+                    }
+                    glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+                    model = glm::scale(model, glm::vec3(CANDLE_SCALE));
+                    shader.setMat4("uModel", model);
+                    candle.draw(lod);
+                };
+                drawCaster(candlePos);
+                for (const SceneCandle &sceneCandle : sceneCandles) {
+                    drawCaster(sceneCandle.position);
+                }
+            });
+        }
+        gpuTimer.end("shadows");
+
+        // Scene geometry, shared by both paths. The forward shaders also light it.
+        auto drawRoom = [&](const Shader &shader) {
+            shader.use();
             glm::mat4 model = glm::mat4(1.0f);
-            roomShader.setMat4("uProjection", proj);
-            roomShader.setMat4("uView", view);
-            roomShader.setMat4("uModel", model);
+            shader.setMat4("uProjection", proj);
+            shader.setMat4("uView", view);
+            shader.setMat4("uModel", model);
 
-            // Set viewPos and lightPos for room
-            roomShader.setVec3("lightPos", flamePos);
-            roomShader.setVec3("viewPos", cameraPos);
-            roomShader.setVec3("lightColor", glm::vec3(2.0f, 1.0f, 0.5f));; // warm flame color
+            shader.setVec3("viewPos", cameraPos);
+            lightClusters.bind(shader, 2, screenSize);
+            shadowAtlas.bind(shader, 5);
 
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, room.albedoTexture);
-            roomShader.setInt("uAlbedoMap",0);
+            shader.setInt("uAlbedoMap",0);
 
             glActiveTexture(GL_TEXTURE1);
             glBindTexture(GL_TEXTURE_2D, room.normalTexture);
-            roomShader.setInt("uNormalMap",1);
+            shader.setInt("uNormalMap",1);
+
+            glActiveTexture(GL_TEXTURE7);
+            glBindTexture(GL_TEXTURE_2D, room.lightmapTexture);
+            shader.setInt("uLightmap",7);
+            shader.setInt("uLightmapEnabled", lightmapEnabled && room.lightmapTexture != 0);
+            glActiveTexture(GL_TEXTURE0);
 
             room.draw();
-        }
+        };
 
-        // Draw Candle
-        candleShader.use();
-        {
-            glm::mat4 model = glm::translate(glm::mat4(1.0f), candlePos);
-            // Increase scale if candle too small
-            model = glm::scale(model, glm::vec3(0.5f,0.5f,0.5f));
-            candleShader.setVec3("viewPos", cameraPos);
-            candleShader.setMat4("uProjection", proj);
-            candleShader.setMat4("uView", view);
-            candleShader.setMat4("uModel", model);
-            candleShader.setVec3("lightPos", flamePos);
-            candleShader.setVec3("lightColor", glm::vec3(2.0f, 1.0f, 0.5f));
-            candleShader.setVec3("candleColor", glm::vec3(0.1f, 0.8f, 0.7f));
+        auto drawCandles = [&](const Shader &shader) {
+            shader.use();
+            shader.setVec3("viewPos", cameraPos);
+            shader.setMat4("uProjection", proj);
+            shader.setMat4("uView", view);
+            shader.setVec3("candleColor", glm::vec3(0.1f, 0.8f, 0.7f));
+            lightClusters.bind(shader, 0, screenSize);
+            shadowAtlas.bind(shader, 3);
+
+            auto drawCandle = [&](const glm::vec3 &position) {
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+                model = glm::scale(model, glm::vec3(CANDLE_SCALE));
+                shader.setMat4("uModel", model);
+
+                // Choose the tessellation level from how big the candle is on screen
+                float distance = glm::max(glm::length(position - cameraPos), 0.01f);
+                float worldRadius = candle.getParams().radius * CANDLE_SCALE;
+                float projectedRadius = worldRadius * proj[1][1] * 0.5f * renderHeight / distance;
+                candle.draw(candle.selectLod(projectedRadius));
+            };
+
+            glDisable(GL_BLEND);
+            if (objectVisible[heldCandleObject]) {
+                drawCandle(candlePos);
+            }
+            for (const SceneCandle &sceneCandle : sceneCandles) {
+                if (objectVisible[sceneCandle.sceneObject]) {
+                    drawCandle(sceneCandle.position);
+                }
+            }
+            glEnable(GL_BLEND);
+        };
 
+        // Everything renders into the HDR target, resolved to the screen at the end
+        postProcess.resize(renderWidth, renderHeight);
+        postProcess.beginScene(glm::vec4(0.05f,0.05f,0.05f,1.0f));
+
+        if (renderPath == RenderPath::Forward) {
+            PROFILE_SCOPE("scene_forward");
+            gpuTimer.begin("scene_forward");
+            gpuTimer.begin("room");
+            drawRoom(roomShader);
+            gpuTimer.end("room");
+            gpuTimer.begin("candles");
+            drawCandles(candleShader);
+            gpuTimer.end("candles");
+            gpuTimer.end("scene_forward");
+        } else {
+            PROFILE_SCOPE("scene_deferred");
+            gpuTimer.begin("scene_deferred");
+            // G-buffer, then one full-screen pass over the clustered lights
+            deferred.resize(renderWidth, renderHeight);
+            deferred.beginGeometryPass();
             glDisable(GL_BLEND);
-            candle.draw();
+            gpuTimer.begin("gbuffer_room");
+            drawRoom(deferred.getRoomShader());
+            gpuTimer.end("gbuffer_room");
+            gpuTimer.begin("gbuffer_candles");
+            drawCandles(deferred.getCandleShader());
+            gpuTimer.end("gbuffer_candles");
             glEnable(GL_BLEND);
+            gpuTimer.begin("deferred_lighting");
+            deferred.lightingPass(lightClusters, view, proj, cameraPos, shadowAtlas,
+                                  postProcess.getSceneFramebuffer());
+            gpuTimer.end("deferred_lighting");
+            arena.invalidateBinding();
+            gpuTimer.end("scene_deferred");
         }
 
-        // Draw Particles
-        particleShader.use();
-        particleShader.setMat4("uProjection", proj);
-        particleShader.setMat4("uView", view);
-// The particle shader now uses gradient in frag; no uniform needed for color
+        // Draw Particles. The sprites overlap a lot, at half resolution they cost a quarter of
+        // the fill and get composited back with a depth aware upsample.
+        bool drawParticles = !frame.fluidFlames;
+        if (drawParticles && halfResParticles) {
+            gpuTimer.begin("particle_depth");
+            particleCompositor.resize(renderWidth, renderHeight);
+            particleCompositor.begin(postProcess.getSceneDepthTexture());
+            gpuTimer.end("particle_depth");
+        }
+        if (drawParticles) {
+            PROFILE_SCOPE("particles");
+            gpuTimer.begin("particles");
+            particleShader.use();
+            particleShader.setMat4("uProjection", proj);
+            particleShader.setMat4("uView", view);
+            particleShader.setFloat("uPointScale", halfResParticles ? particleCompositor.getPointScale() : 1.0f);
+    // The particle shader now uses gradient in frag; no uniform needed for color
 
-        coreFlameEmitter.draw();
-        hazeEmitter.draw();
+            if (sortedParticles) {
+                // Only keys and indices get sorted, the positions are gathered in order into
+                // the upload copy that is made anyway
+                unsortedPositions.clear();
+                for (size_t i = 0; i < emitters.size(); i++) {
+                    if (objectVisible[emitterObjects[i]]) {
+                        const std::vector<float> &positions = frame.particlePositions[i];
+                        unsortedPositions.insert(unsortedPositions.end(), positions.begin(), positions.end());
+                    }
+                }
+                int count = (int)(unsortedPositions.size() / 3);
+                const std::vector<uint32_t> &order = particleSorter.sort(unsortedPositions.data(), count, view);
+                sortedPositions.resize(unsortedPositions.size());
+                for (int i = 0; i < count; i++) {
+                    std::memcpy(&sortedPositions[(size_t)i * 3], &unsortedPositions[(size_t)order[i] * 3], 3 * sizeof(float));
+                }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+                glDepthMask(GL_FALSE);
+                glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+                arena.updateStream(sortedStream, sortedPositions.data(), count);
+                arena.drawArrays(sortedStream, GL_POINTS, count);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+                if (!halfResParticles) {
+                    glDepthMask(GL_TRUE);
+                }
+            } else {
+                for (size_t i = 0; i < emitters.size(); i++) {
+                    if (objectVisible[emitterObjects[i]]) {
+                        emitters[i]->draw(frame.particlePositions[i]);
+                    }
+                }
+            }
+            gpuTimer.end("particles");
+        }
+        if (drawParticles && halfResParticles) {
+            gpuTimer.begin("particle_composite");
+            particleCompositor.composite(postProcess.getSceneColorFramebuffer(),
+                                         postProcess.getSceneDepthTexture(), NEAR_PLANE, FAR_PLANE,
+                                         sortedParticles);
+            arena.invalidateBinding();
+            gpuTimer.end("particle_composite");
+        }
+
+        // Or the fluid flames, marched at full resolution over the scene. A texture is only
+        // uploaded when its grid stepped since the last upload.
+        if (frame.fluidFlames) {
+            PROFILE_SCOPE("flame_volumes");
+            gpuTimer.begin("flame_volumes");
+            flameVolumes.clear();
+            auto drawFlame = [&](int index, const glm::vec3 &position, int object) {
+                const std::vector<uint8_t> &texels = frame.flameVolumes[index];
+                if (texels.empty()) {
+                    return;
+                }
+                if (frame.flameVolumeVersions[index] != uploadedVolumeVersions[index]) {
+                    flameVolumes.upload(index, texels);
+                    uploadedVolumeVersions[index] = frame.flameVolumeVersions[index];
+                }
+                if (objectVisible[object]) {
+                    flameVolumes.add(index, position + FLAME_OFFSET - fluidSourceOffset, fluidBoxSize);
+                }
+            };
+            drawFlame(0, candlePos, heldCandleObject);
+            for (size_t i = 0; i < sceneCandles.size(); i++) {
+                drawFlame((int)i + 1, sceneCandles[i].position, sceneCandles[i].sceneObject);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, postProcess.getSceneFramebuffer());
+            flameVolumes.render(view, proj, cameraPos, screenSize);
+            gpuTimer.end("flame_volumes");
+        }
+
+        {
+            PROFILE_SCOPE("post");
+            gpuTimer.begin("post");
+            postProcess.resolve(gpuTimer, 0, windowWidth, windowHeight);
+            gpuTimer.end("post");
+        }
+        arena.invalidateBinding();
+        gpuTimer.end("frame");
+
+        // Feed the controller. GPU times arrive a few frames late and only when a new sample
+        // came in; the CPU time is everything up to here, without waiting on the swap.
+        int frameSection = gpuTimer.findSection("frame");
+        int frameSamples = frameSection >= 0 ? gpuTimer.getSampleCount(frameSection) : 0;
+        double gpuMs = frameSamples != lastFrameSamples ? gpuTimer.getLastMs(frameSection) : -1.0;
+        lastFrameSamples = frameSamples;
+        double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        if (dynamicResolution) {
+            resolution.update(gpuMs, cpuMs);
+        } else {
+            resolution.reset();
+        }
+
+        if (printGpuTimings) {
+            std::cout << "GPU passes:" << std::endl;
+            gpuTimer.report(std::cout);
+            std::cout << "Visible candles: " << std::count(objectVisible.begin(), objectVisible.end(), 1)
+                      << "/" << sceneIndex.getObjectCount() << " (" << sceneIndex.getNodeCount() << " BVH nodes, "
+                      << sceneIndex.getRebuildCount() << " rebuilds)" << std::endl;
+            std::cout << "Particles: " << frame.liveParticles << " live, budget " << options.particleLod.particleBudget
+                      << " (scale " << frame.particleBudgetScale << ")" << std::endl;
+            if (frame.fluidFlames) {
+                int stepped = 0;
+                for (const std::vector<uint8_t> &texels : frame.flameVolumes) {
+                    stepped += texels.empty() ? 0 : 1;
+                }
+                std::cout << "Fluid flames: " << stepped << "/" << frame.flameVolumes.size() << " grids simulated, "
+                          << fluidSettings.sizeX << "x" << fluidSettings.sizeY << "x" << fluidSettings.sizeZ
+                          << " cells each, at most " << MAX_FLUID_STEPS << " stepped per simulation step" << std::endl;
+                std::cout << "Flame volumes: " << flameVolumes.getLastFlameCount() << " drawn, "
+                          << flameVolumes.getLastCost() << "M samples wanted, budget "
+                          << flameVolumes.getSettings().sampleBudget << "M (" << flameVolumes.getSampleRate()
+                          << " samples per cell)" << std::endl;
+            }
+            std::cout << "Render resolution: " << renderWidth << "x" << renderHeight
+                      << " (scale " << resolution.getScale() << ", GPU " << resolution.getGpuMs()
+                      << " ms, CPU " << resolution.getCpuMs() << " ms)" << std::endl;
+            std::cout << "Input to present: " << framePacer.getSwapLatencyMs() << " ms to swap, "
+                      << framePacer.getPresentLatencyMs() << " ms to GPU done (max "
+                      << framePacer.getMaxPresentLatencyMs() << " ms), vsync "
+                      << VSYNC_NAMES[(int)framePacer.getVsync()] << std::endl;
+            printGpuTimings = false;
+        }
+        if (writeTraceRequested) {
+            writeTraceRequested = false;
+            if (!PROFILER_ENABLED) {
+                std::cout << "CPU profiling is compiled out, build with -DCANDLE_PROFILE" << std::endl;
+            } else {
+                std::string path = "trace_" + std::to_string(traceCount++) + ".json";
+                if (writeChromeTrace(path)) {
+                    std::cout << "CPU trace written to " << path << std::endl;
+                }
+            }
+        }
+
+        if (benchmark) {
+            glFinish();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+            BenchResult &result = benchResults[(int)renderPath];
+            result.totalMs += ms;
+            result.maxMs = std::max(result.maxMs, ms);
+            result.frames++;
+            if (++benchFrame >= options.benchFrames * RENDER_PATH_COUNT) {
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
+            }
+        }
+
+        {
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(window);
+            framePacer.presented();
+        }
 
     }
+    simulation.stop();
+    arena.freeStream(sortedStream);
+    finishRecording();
+
+    if (benchmark) {
+        std::cout << "Benchmark: " << options.benchFrames << " frames per path, "
+                  << snapshots.readBuffer().lights.size() << " lights, " << windowWidth << "x" << windowHeight << std::endl;
+        for (int i = 0; i < RENDER_PATH_COUNT; i++) {
+            const BenchResult &result = benchResults[i];
+            std::cout << "  " << RENDER_PATH_NAMES[i] << ": "
+                      << result.totalMs / std::max(result.frames, 1) << " ms avg, "
+                      << result.maxMs << " ms max" << std::endl;
+        }
+        std::cout << "GPU passes:" << std::endl;
+        gpuTimer.report(std::cout);
+        if (gpuCsv.is_open()) {
+            gpuTimer.setCsvOutput(nullptr);
+            std::cout << "Per frame GPU timings written to " << options.csvPath << std::endl;
+        }
+    }
+
+    if (!options.tracePath.empty()) {
+        if (!PROFILER_ENABLED) {
+            std::cerr << "--trace needs a build with -DCANDLE_PROFILE" << std::endl;
+        } else if (writeChromeTrace(options.tracePath)) {
+            std::cout << "CPU trace written to " << options.tracePath << std::endl;
+        }
+    }
 
     glfwTerminate();
     return 0;